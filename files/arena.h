@@ -0,0 +1,184 @@
+// arena
+
+#ifndef H_PCT_ARENA
+#define H_PCT_ARENA
+
+#include "header.h"  // [M[ IGNORE ]M]
+
+// bump pointer allocator, everything is released at once by Arena_reset
+// install it with pct_allocator_set_local(Arena_allocator(arena)) to build
+// Strings, Arrays, Hashmaps ... for one request and drop them in a single reset
+
+#define ARENA_DEFAULT_CHUNK 65536
+#define ARENA_ALIGN 16
+
+typedef struct _ArenaChunk {
+    struct _ArenaChunk *prev;
+    size_t size;
+    size_t used;
+    size_t last;
+} ArenaChunk;
+
+typedef struct _ArenaMark {
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+typedef struct _Arena {
+    ArenaChunk *chunk;
+    size_t chunkSize;
+    PctAllocator *parent;
+    PctAllocator allocator;
+} Arena;
+
+// every block is prefixed with its size, so realloc knows what to copy
+#define _ARENA_HEADER ARENA_ALIGN
+#define _ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+#define _ARENA_DATA(chunk) ((char *)(chunk) + _ARENA_ROUND(sizeof(ArenaChunk)))
+
+ArenaChunk *_arena_chunk_new(Arena *this, size_t size)
+{
+    size = MAX(size, this->chunkSize);
+    ArenaChunk *chunk = this->parent->malloc(this->parent->context, _ARENA_ROUND(sizeof(ArenaChunk)) + size);
+    if (chunk == NULL) return NULL;
+    chunk->prev = this->chunk;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->last = 0;
+    this->chunk = chunk;
+    return chunk;
+}
+
+bool _arena_owns(Arena *this, void *object)
+{
+    char *ptr = object;
+    for (ArenaChunk *chunk = this->chunk; chunk != NULL; chunk = chunk->prev) {
+        char *data = _ARENA_DATA(chunk);
+        if (ptr >= data && ptr < data + chunk->used) return true;
+    }
+    return false;
+}
+
+size_t _arena_block_size(void *object)
+{
+    return *(size_t *)((char *)object - _ARENA_HEADER);
+}
+
+void *Arena_alloc(Arena *this, size_t size)
+{
+    size_t need = _ARENA_HEADER + _ARENA_ROUND(size);
+    ArenaChunk *chunk = this->chunk;
+    if (chunk == NULL || chunk->used + need > chunk->size) {
+        chunk = _arena_chunk_new(this, need);
+        if (chunk == NULL) return NULL;
+    }
+    char *block = _ARENA_DATA(chunk) + chunk->used;
+    *(size_t *)block = size;
+    chunk->last = chunk->used;
+    chunk->used += need;
+    return block + _ARENA_HEADER;
+}
+
+void *Arena_realloc(Arena *this, void *object, size_t size)
+{
+    if (object == NULL) return Arena_alloc(this, size);
+    if (!_arena_owns(this, object)) return this->parent->realloc(this->parent->context, object, size);
+    size_t old = _arena_block_size(object);
+    ArenaChunk *chunk = this->chunk;
+    char *block = (char *)object - _ARENA_HEADER;
+    // the newest block grows in place
+    if (block == _ARENA_DATA(chunk) + chunk->last && chunk->last + _ARENA_HEADER + _ARENA_ROUND(size) <= chunk->size) {
+        *(size_t *)block = size;
+        chunk->used = chunk->last + _ARENA_HEADER + _ARENA_ROUND(size);
+        return object;
+    }
+    if (size <= old) {
+        *(size_t *)block = size;
+        return object;
+    }
+    void *other = Arena_alloc(this, size);
+    if (other != NULL) memcpy(other, object, old);
+    return other;
+}
+
+// only the newest block is given back, the rest waits for a reset
+void Arena_release(Arena *this, void *object)
+{
+    if (object == NULL) return;
+    if (!_arena_owns(this, object)) return this->parent->free(this->parent->context, object);
+    ArenaChunk *chunk = this->chunk;
+    char *block = (char *)object - _ARENA_HEADER;
+    if (block == _ARENA_DATA(chunk) + chunk->last) chunk->used = chunk->last;
+}
+
+ArenaMark Arena_mark(Arena *this)
+{
+    ArenaMark mark = {this->chunk, this->chunk != NULL ? this->chunk->used : 0};
+    return mark;
+}
+
+// drops everything allocated after the mark
+void Arena_reset(Arena *this, ArenaMark mark)
+{
+    while (this->chunk != NULL && this->chunk != mark.chunk) {
+        ArenaChunk *chunk = this->chunk;
+        this->chunk = chunk->prev;
+        this->parent->free(this->parent->context, chunk);
+    }
+    if (this->chunk != NULL) {
+        this->chunk->used = mark.used;
+        this->chunk->last = mark.used;
+    }
+}
+
+// drops everything but keeps the oldest chunk for reuse
+void Arena_clear(Arena *this)
+{
+    ArenaChunk *chunk = this->chunk;
+    while (chunk != NULL && chunk->prev != NULL) chunk = chunk->prev;
+    ArenaMark mark = {chunk, 0};
+    Arena_reset(this, mark);
+}
+
+void *_arena_malloc(void *context, size_t size)
+{
+    return Arena_alloc(context, size);
+}
+
+void *_arena_realloc(void *context, void *object, size_t size)
+{
+    return Arena_realloc(context, object, size);
+}
+
+void _arena_free(void *context, void *object)
+{
+    Arena_release(context, object);
+}
+
+Arena *Arena_new(size_t chunkSize)
+{
+    PctAllocator *parent = pct_allocator_get();
+    Arena *arena = parent->malloc(parent->context, sizeof(Arena));
+    arena->chunk = NULL;
+    arena->chunkSize = chunkSize > 0 ? chunkSize : ARENA_DEFAULT_CHUNK;
+    arena->parent = parent;
+    arena->allocator.malloc = _arena_malloc;
+    arena->allocator.realloc = _arena_realloc;
+    arena->allocator.free = _arena_free;
+    arena->allocator.context = arena;
+    return arena;
+}
+
+PctAllocator *Arena_allocator(Arena *this)
+{
+    return &this->allocator;
+}
+
+void Arena_free(Arena *this)
+{
+    ArenaMark mark = {NULL, 0};
+    Arena_reset(this, mark);
+    this->parent->free(this->parent->context, this);
+}
+
+#endif
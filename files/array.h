@@ -4,10 +4,20 @@
 #define H_PCT_ARRAY
 
 #define ARRAY_DEFAULT_CAPACITY 1024
+#define ARRAY_MIN_CAPACITY 8
 #define ARRAY_INVALID_INDEX 0
+// sorting: runs this short are insertion sorted, shorter arrays never go parallel
+#define ARRAY_SORT_RUN 32
+#define ARRAY_PARALLEL_MIN 8192
+#define ARRAY_MAX_THREADS 64
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 typedef int (* ArraySortFunction)(void const*, void const*);
 typedef bool (* ArrayFindFunction)(void const*);
+typedef uint64_t (* ArrayKeyFunction)(void const*);
 
 typedef struct _Array {
     struct _Object;
@@ -27,7 +37,6 @@ Array *Array_new(bool isRetainValue)
     array->length = 0;
     array->nullable = false;
     array->elements = (void *)pct_mallloc(sizeof(void *) * array->capacity);
-    for (int i = array->length; i < array->capacity; i++) array->elements[i] = NULL;
     return array;
 }
 
@@ -50,19 +59,40 @@ void Array_free(Array *this)
     Object_free(this);
 }
 
-bool _array_check_resize(Array *this, int length)
+// slots past length are garbage, whoever extends length fills them
+bool _array_resize(Array *this, int capacity)
 {
-    if (length <= this->capacity) return true;
-    int capacity = this->capacity;
-    while (length > capacity) capacity = capacity + ARRAY_DEFAULT_CAPACITY;
-    void **elements = pct_realloc(this->elements, sizeof(void *) * capacity);
+    void **elements = pct_realloc(this->elements, sizeof(void *) * MAX(capacity, 1));
     if (elements == NULL) return false;
     this->capacity = capacity;
     this->elements = elements;
-    for (int i = this->length; i < this->capacity; i++) this->elements[i] = NULL;
     return true;
 }
 
+// grows by doubling, so appending n elements costs O(log n) reallocs
+bool _array_check_resize(Array *this, int length)
+{
+    if (length <= this->capacity) return true;
+    if (length < 0) return false;
+    int capacity = this->capacity < INT_MAX / 2 ? this->capacity * 2 : INT_MAX;
+    capacity = MAX(capacity, MAX(length, ARRAY_MIN_CAPACITY));
+    return _array_resize(this, capacity);
+}
+
+// room for capacity elements without another realloc
+bool Array_reserve(Array *this, int capacity)
+{
+    if (capacity <= this->capacity) return true;
+    return _array_resize(this, capacity);
+}
+
+// gives the unused slots back
+bool Array_shrink(Array *this)
+{
+    if (this->length == this->capacity) return true;
+    return _array_resize(this, this->length);
+}
+
 bool Array_set(Array *this, int index, void *element)
 {
     if (!this->nullable && element == NULL) return false;
@@ -70,7 +100,9 @@ bool Array_set(Array *this, int index, void *element)
     int length = index < this->length ? this->length : index + 1;
     bool isOk = _array_check_resize(this, length);
     if (!isOk) return false;
-    if (this->elements[index] != NULL) {
+    if (index >= this->length) {
+        memset(this->elements + this->length, 0, sizeof(void *) * (length - this->length));
+    } else if (this->elements[index] != NULL) {
         if (this->retain) {
             Object_release(this->elements[index]);
         }
@@ -103,11 +135,20 @@ void *Array_del(Array *this, int index)
 {
     if (index < 0 || index >= this->length) return NULL;
     void *item = this->elements[index];
-    for(int i = index; i < this->length; i++)
-    {
-        this->elements[i] = i != (this->length - 1) ? this->elements[i + 1] : NULL;
+    memmove(this->elements + index, this->elements + index + 1, sizeof(void *) * (this->length - index - 1));
+    this->length = this->length - 1;
+    if (this->retain) {
+        Object_release(item);
     }
-    this->elements[this->length] = NULL;
+    return item;
+}
+
+// O(1) removal, the last element takes the hole so the order is not kept
+void *Array_swapRemove(Array *this, int index)
+{
+    if (index < 0 || index >= this->length) return NULL;
+    void *item = this->elements[index];
+    this->elements[index] = this->elements[this->length - 1];
     this->length = this->length - 1;
     if (this->retain) {
         Object_release(item);
@@ -136,26 +177,15 @@ bool _array_insert(Array *this, int index, void *element, bool isBefore)
         index = this->length - 1;
         isBefore = false;
     }
-    if (this->retain) {
-        Object_retain(element);
-    }
-    // 
-    if (this->length == 0)
-    {
-        this->elements[0] = element;
-        this->length = 1;
-        return true;
-    }
     // resize
     bool isOk = _array_check_resize(this, this->length + 1);
     if (!isOk) return false;
+    if (this->retain) {
+        Object_retain(element);
+    }
     // insert
-    int i = this->length;
     int to = isBefore ? index : index + 1;
-    for (i = this->length - 1; i >= to; i--)
-    {
-        this->elements[i + 1] = this->elements[i];
-    }
+    memmove(this->elements + to + 1, this->elements + to, sizeof(void *) * (this->length - to));
     this->elements[to] = element;
     this->length = this->length + 1;
     return true;
@@ -181,6 +211,25 @@ bool Array_append(Array *this, void *element)
     return Array_insertAfter(this, this->length - 1, element);
 }
 
+// appends count elements from a pointer range with at most one realloc,
+// nothing is added if a NULL shows up in a non nullable array
+bool Array_appendMany(Array *this, void **elements, int count)
+{
+    if (count <= 0) return count == 0;
+    if (!this->nullable) {
+        for (int i = 0; i < count; i++) if (elements[i] == NULL) return false;
+    }
+    if (count > INT_MAX - this->length) return false;
+    bool isOk = _array_check_resize(this, this->length + count);
+    if (!isOk) return false;
+    memcpy(this->elements + this->length, elements, sizeof(void *) * count);
+    if (this->retain) {
+        for (int i = 0; i < count; i++) if (elements[i] != NULL) Object_retain(elements[i]);
+    }
+    this->length = this->length + count;
+    return true;
+}
+
 bool Array_push(Array *this, void *element)
 {
     return Array_insertAfter(this, this->length - 1, element);
@@ -207,6 +256,289 @@ void Array_sort(Array *this, ArraySortFunction func)
     qsort(this->elements, this->length, sizeof(void *), func);
 }
 
+void _array_insertion_sort(void **elements, int from, int to, ArraySortFunction func)
+{
+    for (int i = from + 1; i < to; i++) {
+        void *item = elements[i];
+        int j = i;
+        while (j > from && func(&elements[j - 1], &item) > 0) {
+            elements[j] = elements[j - 1];
+            j--;
+        }
+        elements[j] = item;
+    }
+}
+
+// stable, ties keep the one from a first
+void _array_merge_range(void **a, int m, void **b, int n, void **out, ArraySortFunction func)
+{
+    int i = 0, j = 0, k = 0;
+    while (i < m && j < n) out[k++] = func(&b[j], &a[i]) < 0 ? b[j++] : a[i++];
+    if (i < m) memcpy(out + k, a + i, sizeof(void *) * (m - i));
+    if (j < n) memcpy(out + k + (m - i), b + j, sizeof(void *) * (n - j));
+}
+
+// bottom up merge sort of elements[from, to), tmp is scratch of the same size
+void _array_merge_sort(void **elements, void **tmp, int from, int to, ArraySortFunction func)
+{
+    for (int i = from; i < to; i += ARRAY_SORT_RUN) _array_insertion_sort(elements, i, MIN(i + ARRAY_SORT_RUN, to), func);
+    void **src = elements;
+    void **dst = tmp;
+    for (int width = ARRAY_SORT_RUN; width < to - from; width *= 2) {
+        for (int i = from; i < to; i += 2 * width) {
+            int middle = MIN(i + width, to);
+            int end = MIN(i + 2 * width, to);
+            _array_merge_range(src + i, middle - i, src + middle, end - middle, dst + i, func);
+        }
+        void **swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != elements) memcpy(elements + from, src + from, sizeof(void *) * (to - from));
+}
+
+// equal elements keep their order, needs length pointers of scratch memory
+bool Array_sortStable(Array *this, ArraySortFunction func)
+{
+    if (this->length < 2) return true;
+    void **tmp = pct_mallloc(sizeof(void *) * this->length);
+    if (tmp == NULL) return false;
+    _array_merge_sort(this->elements, tmp, 0, this->length, func);
+    pct_free(tmp);
+    return true;
+}
+
+// parallel merge sort: every worker sorts one chunk, then the chunks are merged pairwise,
+// merges are cut into pieces by co-rank so late rounds with few pairs still keep all workers busy
+typedef struct _ArraySortJob {
+    void **src;
+    void **dst;
+    ArraySortFunction func;
+    int threads;
+    int runs[ARRAY_MAX_THREADS + 1];
+    int runCount;
+    int parts;
+    int taskCount;
+    void (*task)(struct _ArraySortJob *, int);
+} ArraySortJob;
+
+typedef struct _ArraySortWorker {
+    ArraySortJob *job;
+    int index;
+} ArraySortWorker;
+
+void _array_sort_chunk(ArraySortJob *job, int task)
+{
+    _array_merge_sort(job->src, job->dst, job->runs[task], job->runs[task + 1], job->func);
+}
+
+// how many of the first k merged elements come from a, ties favour a
+int _array_corank(void **a, int m, void **b, int n, int k, ArraySortFunction func)
+{
+    int low = MAX(0, k - n);
+    int high = MIN(k, m);
+    while (low < high) {
+        int i = low + (high - low) / 2;
+        int j = k - i;
+        if (i < m && j > 0 && func(&b[j - 1], &a[i]) >= 0) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+    return low;
+}
+
+void _array_merge_part(ArraySortJob *job, int task)
+{
+    int pair = task / job->parts;
+    int part = task % job->parts;
+    int from = job->runs[pair * 2];
+    int middle = job->runs[MIN(pair * 2 + 1, job->runCount)];
+    int to = job->runs[MIN(pair * 2 + 2, job->runCount)];
+    void **a = job->src + from;
+    void **b = job->src + middle;
+    int m = middle - from;
+    int n = to - middle;
+    int k0 = (int)((long long)(to - from) * part / job->parts);
+    int k1 = (int)((long long)(to - from) * (part + 1) / job->parts);
+    int i0 = _array_corank(a, m, b, n, k0, job->func);
+    int i1 = _array_corank(a, m, b, n, k1, job->func);
+    _array_merge_range(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), job->dst + from + k0, job->func);
+}
+
+void *_array_sort_worker(void *data)
+{
+    ArraySortWorker *worker = data;
+    ArraySortJob *job = worker->job;
+    for (int task = worker->index; task < job->taskCount; task += job->threads) job->task(job, task);
+    return NULL;
+}
+
+// the calling thread is worker 0, on windows everything stays on it
+void _array_sort_run(ArraySortJob *job)
+{
+    ArraySortWorker workers[ARRAY_MAX_THREADS];
+    for (int i = 0; i < job->threads; i++) {
+        workers[i].job = job;
+        workers[i].index = i;
+    }
+    #ifndef _WIN32
+    pthread_t threads[ARRAY_MAX_THREADS];
+    for (int i = 1; i < job->threads; i++) pthread_create(&threads[i], NULL, _array_sort_worker, &workers[i]);
+    _array_sort_worker(&workers[0]);
+    for (int i = 1; i < job->threads; i++) pthread_join(threads[i], NULL);
+    #else
+    for (int i = 0; i < job->threads; i++) _array_sort_worker(&workers[i]);
+    #endif
+}
+
+// stable like Array_sortStable, func is called from several threads at once
+bool Array_sortParallel(Array *this, ArraySortFunction func, int threads)
+{
+    threads = MAX(1, MIN(threads, ARRAY_MAX_THREADS));
+    if (threads == 1 || this->length < ARRAY_PARALLEL_MIN) return Array_sortStable(this, func);
+    void **tmp = pct_mallloc(sizeof(void *) * this->length);
+    if (tmp == NULL) return false;
+    ArraySortJob job;
+    job.src = this->elements;
+    job.dst = tmp;
+    job.func = func;
+    job.threads = threads;
+    job.runCount = threads;
+    for (int i = 0; i <= threads; i++) job.runs[i] = (int)((long long)this->length * i / threads);
+    job.taskCount = threads;
+    job.task = _array_sort_chunk;
+    _array_sort_run(&job);
+    job.task = _array_merge_part;
+    while (job.runCount > 1) {
+        int pairs = (job.runCount + 1) / 2;
+        job.parts = MAX(1, threads / pairs);
+        job.taskCount = pairs * job.parts;
+        _array_sort_run(&job);
+        for (int i = 0; i < pairs; i++) job.runs[i + 1] = job.runs[MIN(i * 2 + 2, job.runCount)];
+        job.runCount = pairs;
+        void **swap = job.src;
+        job.src = job.dst;
+        job.dst = swap;
+    }
+    if (job.src != this->elements) memcpy(this->elements, job.src, sizeof(void *) * this->length);
+    pct_free(tmp);
+    return true;
+}
+
+// radix keys, unsigned order of the result matches the numeric order of the input
+uint64_t array_key_int64(int64_t value)
+{
+    return (uint64_t)value ^ (1ULL << 63);
+}
+
+uint64_t array_key_double(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+typedef struct _ArrayKeyed {
+    uint64_t key;
+    void *item;
+} ArrayKeyed;
+
+// lsd radix sort on func(element), stable, func runs once per element,
+// bytes every key shares are skipped
+bool Array_sortByKey(Array *this, ArrayKeyFunction func)
+{
+    int length = this->length;
+    if (length < 2) return true;
+    ArrayKeyed *src = pct_mallloc(sizeof(ArrayKeyed) * length * 2);
+    if (src == NULL) return false;
+    ArrayKeyed *dst = src + length;
+    size_t (*counts)[256] = pct_mallloc(sizeof(size_t) * 8 * 256);
+    if (counts == NULL) {
+        pct_free(src);
+        return false;
+    }
+    memset(counts, 0, sizeof(size_t) * 8 * 256);
+    for (int i = 0; i < length; i++) {
+        uint64_t key = func(this->elements[i]);
+        src[i].key = key;
+        src[i].item = this->elements[i];
+        for (int b = 0; b < 8; b++) counts[b][(key >> (b * 8)) & 0xff]++;
+    }
+    ArrayKeyed *from = src;
+    ArrayKeyed *to = dst;
+    for (int b = 0; b < 8; b++) {
+        size_t *count = counts[b];
+        if (count[(from[0].key >> (b * 8)) & 0xff] == (size_t)length) continue;
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (int i = 0; i < length; i++) to[count[(from[i].key >> (b * 8)) & 0xff]++] = from[i];
+        ArrayKeyed *swap = from;
+        from = to;
+        to = swap;
+    }
+    for (int i = 0; i < length; i++) this->elements[i] = from[i].item;
+    pct_free(counts);
+    pct_free(src);
+    return true;
+}
+
+void _array_heap_down(int *heap, int count, int at, Array **arrays, int *positions, ArraySortFunction func)
+{
+    while (true) {
+        int smallest = at;
+        for (int child = at * 2 + 1; child <= at * 2 + 2 && child < count; child++) {
+            int x = heap[child];
+            int y = heap[smallest];
+            int order = func(&arrays[x]->elements[positions[x]], &arrays[y]->elements[positions[y]]);
+            if (order < 0 || (order == 0 && x < y)) smallest = child;
+        }
+        if (smallest == at) return;
+        int swap = heap[at];
+        heap[at] = heap[smallest];
+        heap[smallest] = swap;
+        at = smallest;
+    }
+}
+
+// k-way merge of arrays already sorted by func into a new one, ties keep the earlier array first,
+// the result retains its values if the first input does
+Array *Array_merge(Array **arrays, int count, ArraySortFunction func)
+{
+    Array *merged = Array_new(count > 0 && arrays[0]->retain);
+    if (count <= 0) return merged;
+    merged->nullable = arrays[0]->nullable;
+    int total = 0;
+    int *heap = pct_mallloc(sizeof(int) * count * 2);
+    int *positions = heap + count;
+    int size = 0;
+    for (int i = 0; i < count; i++) {
+        positions[i] = 0;
+        total += arrays[i]->length;
+        if (arrays[i]->length > 0) heap[size++] = i;
+    }
+    if (!Array_reserve(merged, total)) {
+        pct_free(heap);
+        return merged;
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) _array_heap_down(heap, size, i, arrays, positions, func);
+    while (size > 0) {
+        int x = heap[0];
+        void *item = arrays[x]->elements[positions[x]++];
+        if (merged->retain && item != NULL) Object_retain(item);
+        merged->elements[merged->length++] = item;
+        if (positions[x] == arrays[x]->length) heap[0] = heap[--size];
+        _array_heap_down(heap, size, 0, arrays, positions, func);
+    }
+    pct_free(heap);
+    return merged;
+}
+
 // int search(const void *num2) { return true; }
 int Array_find(Array *this, int from, int to, bool isReverse, ArrayFindFunction func)
 {
@@ -231,7 +563,8 @@ Array *Array_slice(Array *this, int from, int to)
 {
     Array *other = Array_new(this->retain);
     if (from < 0 || to > this->length || from >= to) return other;
-    for (int i = from; i < to; i++) Array_append(other, Array_get(this, i));
+    other->nullable = this->nullable;
+    Array_appendMany(other, this->elements + from, to - from);
     return other;
 }
 
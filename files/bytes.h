@@ -0,0 +1,352 @@
+// bytes
+
+#ifndef H_PCT_BYTES
+#define H_PCT_BYTES
+
+#include "header.h"  // [M[ IGNORE ]M]
+
+// ascii byte kernels with sse2/avx2 paths picked at runtime,
+// define PCT_BYTES_NO_SIMD to build the scalar fallback only
+
+#if !defined(PCT_BYTES_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define PCT_BYTES_X86
+#include <immintrin.h>
+#endif
+
+#define BYTES_LEVEL_SCALAR 0
+#define BYTES_LEVEL_SSE2 1
+#define BYTES_LEVEL_AVX2 2
+
+// character classes, ascii only like the "C" locale
+#define BYTES_CLASS_SPACE 0
+#define BYTES_CLASS_DIGIT 1
+#define BYTES_CLASS_UPPER 2
+#define BYTES_CLASS_LOWER 3
+#define BYTES_CLASS_ALPHA 4
+#define BYTES_CLASS_ALNUM 5
+
+int _bytes_level = -1;
+
+int bytes_simd_level()
+{
+    if (_bytes_level >= 0) return _bytes_level;
+    _bytes_level = BYTES_LEVEL_SCALAR;
+    #ifdef PCT_BYTES_X86
+    _bytes_level = BYTES_LEVEL_SSE2;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) _bytes_level = BYTES_LEVEL_AVX2;
+    #endif
+    return _bytes_level;
+}
+
+// lowers the level for testing or benchmarking, never raises it above the cpu
+void bytes_set_simd_level(int level)
+{
+    _bytes_level = -1;
+    _bytes_level = MIN(level, bytes_simd_level());
+}
+
+bool _bytes_is_class(unsigned char c, int cls)
+{
+    switch (cls) {
+        case BYTES_CLASS_SPACE: return c == ' ' || (c >= '\t' && c <= '\r');
+        case BYTES_CLASS_DIGIT: return c >= '0' && c <= '9';
+        case BYTES_CLASS_UPPER: return c >= 'A' && c <= 'Z';
+        case BYTES_CLASS_LOWER: return c >= 'a' && c <= 'z';
+        case BYTES_CLASS_ALPHA: return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+        case BYTES_CLASS_ALNUM: return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+    }
+    return false;
+}
+
+void _bytes_case_scalar(char *ptr, size_t len, char from, char to)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (ptr[i] >= from && ptr[i] <= to) ptr[i] ^= 0x20;
+    }
+}
+
+void _bytes_reverse_scalar(char *left, char *right)
+{
+    char temp;
+    while (left < right) {
+        temp = *left;
+        *left++ = *right;
+        *right-- = temp;
+    }
+}
+
+#ifdef PCT_BYTES_X86
+
+// signed compares are fine, every class is below 0x80
+#define _BYTES_IN_RANGE_128(v, a, b) _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((a) - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8((b) + 1)))
+#define _BYTES_IN_RANGE_256(v, a, b) _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((a) - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8((b) + 1), v))
+
+__m128i _bytes_class_sse2(__m128i v, int cls)
+{
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    switch (cls) {
+        case BYTES_CLASS_SPACE: return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _BYTES_IN_RANGE_128(v, '\t', '\r'));
+        case BYTES_CLASS_DIGIT: return _BYTES_IN_RANGE_128(v, '0', '9');
+        case BYTES_CLASS_UPPER: return _BYTES_IN_RANGE_128(v, 'A', 'Z');
+        case BYTES_CLASS_LOWER: return _BYTES_IN_RANGE_128(v, 'a', 'z');
+        case BYTES_CLASS_ALPHA: return _BYTES_IN_RANGE_128(folded, 'a', 'z');
+        case BYTES_CLASS_ALNUM: return _mm_or_si128(_BYTES_IN_RANGE_128(folded, 'a', 'z'), _BYTES_IN_RANGE_128(v, '0', '9'));
+    }
+    return _mm_setzero_si128();
+}
+
+__attribute__((target("avx2")))
+__m256i _bytes_class_avx2(__m256i v, int cls)
+{
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    switch (cls) {
+        case BYTES_CLASS_SPACE: return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _BYTES_IN_RANGE_256(v, '\t', '\r'));
+        case BYTES_CLASS_DIGIT: return _BYTES_IN_RANGE_256(v, '0', '9');
+        case BYTES_CLASS_UPPER: return _BYTES_IN_RANGE_256(v, 'A', 'Z');
+        case BYTES_CLASS_LOWER: return _BYTES_IN_RANGE_256(v, 'a', 'z');
+        case BYTES_CLASS_ALPHA: return _BYTES_IN_RANGE_256(folded, 'a', 'z');
+        case BYTES_CLASS_ALNUM: return _mm256_or_si256(_BYTES_IN_RANGE_256(folded, 'a', 'z'), _BYTES_IN_RANGE_256(v, '0', '9'));
+    }
+    return _mm256_setzero_si256();
+}
+
+size_t _bytes_case_sse2(char *ptr, size_t len, char from, char to)
+{
+    size_t i = 0;
+    __m128i flip = _mm_set1_epi8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i *)(ptr + i));
+        __m128i mask = _BYTES_IN_RANGE_128(v, from, to);
+        _mm_storeu_si128((__m128i *)(ptr + i), _mm_xor_si128(v, _mm_and_si128(mask, flip)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _bytes_case_avx2(char *ptr, size_t len, char from, char to)
+{
+    size_t i = 0;
+    __m256i flip = _mm256_set1_epi8(0x20);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((__m256i *)(ptr + i));
+        __m256i mask = _BYTES_IN_RANGE_256(v, from, to);
+        _mm256_storeu_si256((__m256i *)(ptr + i), _mm256_xor_si256(v, _mm256_and_si256(mask, flip)));
+    }
+    return i;
+}
+
+__m128i _bytes_reverse_128(__m128i v)
+{
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+// swaps blocks from both ends, returns how many bytes each end handled
+size_t _bytes_reverse_sse2(char *ptr, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len - i; i += 16) {
+        __m128i a = _mm_loadu_si128((__m128i *)(ptr + i));
+        __m128i b = _mm_loadu_si128((__m128i *)(ptr + len - i - 16));
+        _mm_storeu_si128((__m128i *)(ptr + i), _bytes_reverse_128(b));
+        _mm_storeu_si128((__m128i *)(ptr + len - i - 16), _bytes_reverse_128(a));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _bytes_reverse_avx2(char *ptr, size_t len)
+{
+    size_t i = 0;
+    __m256i mask = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    for (; i + 64 <= len - i; i += 32) {
+        __m256i a = _mm256_loadu_si256((__m256i *)(ptr + i));
+        __m256i b = _mm256_loadu_si256((__m256i *)(ptr + len - i - 32));
+        a = _mm256_permute2x128_si256(_mm256_shuffle_epi8(a, mask), a, 0x01);
+        b = _mm256_permute2x128_si256(_mm256_shuffle_epi8(b, mask), b, 0x01);
+        _mm256_storeu_si256((__m256i *)(ptr + i), b);
+        _mm256_storeu_si256((__m256i *)(ptr + len - i - 32), a);
+    }
+    return i;
+}
+
+size_t _bytes_count_sse2(const char *ptr, size_t len, char c, size_t *count)
+{
+    size_t i = 0;
+    __m128i needle = _mm_set1_epi8(c);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(ptr + i));
+        *count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _bytes_count_avx2(const char *ptr, size_t len, char c, size_t *count)
+{
+    size_t i = 0;
+    __m256i needle = _mm256_set1_epi8(c);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        *count += __builtin_popcount((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+    }
+    return i;
+}
+
+// first index whose class membership equals isMember, or len
+size_t _bytes_scan_sse2(const char *ptr, size_t len, int cls, bool isMember, size_t *found)
+{
+    size_t i = 0;
+    unsigned int flip = isMember ? 0 : 0xFFFF;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(ptr + i));
+        unsigned int mask = (_mm_movemask_epi8(_bytes_class_sse2(v, cls)) ^ flip) & 0xFFFF;
+        if (mask != 0) {
+            *found = i + __builtin_ctz(mask);
+            return i;
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t _bytes_scan_avx2(const char *ptr, size_t len, int cls, bool isMember, size_t *found)
+{
+    size_t i = 0;
+    unsigned int flip = isMember ? 0 : 0xFFFFFFFF;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_bytes_class_avx2(v, cls)) ^ flip;
+        if (mask != 0) {
+            *found = i + __builtin_ctz(mask);
+            return i;
+        }
+    }
+    return i;
+}
+
+// blocks from the end backwards, returns how many tail bytes were consumed
+size_t _bytes_scan_back_sse2(const char *ptr, size_t len, int cls, bool isMember, size_t *found)
+{
+    size_t i = len;
+    unsigned int flip = isMember ? 0 : 0xFFFF;
+    for (; i >= 16; i -= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(ptr + i - 16));
+        unsigned int mask = (_mm_movemask_epi8(_bytes_class_sse2(v, cls)) ^ flip) & 0xFFFF;
+        if (mask != 0) {
+            *found = i - 16 + (31 - __builtin_clz(mask));
+            return len - i;
+        }
+    }
+    return len - i;
+}
+
+__attribute__((target("avx2")))
+size_t _bytes_scan_back_avx2(const char *ptr, size_t len, int cls, bool isMember, size_t *found)
+{
+    size_t i = len;
+    unsigned int flip = isMember ? 0 : 0xFFFFFFFF;
+    for (; i >= 32; i -= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(ptr + i - 32));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_bytes_class_avx2(v, cls)) ^ flip;
+        if (mask != 0) {
+            *found = i - 32 + (31 - __builtin_clz(mask));
+            return len - i;
+        }
+    }
+    return len - i;
+}
+
+#endif
+
+void _bytes_case(char *ptr, size_t len, char from, char to)
+{
+    size_t done = 0;
+    #ifdef PCT_BYTES_X86
+    int level = bytes_simd_level();
+    if (level == BYTES_LEVEL_AVX2) done = _bytes_case_avx2(ptr, len, from, to);
+    else if (level == BYTES_LEVEL_SSE2) done = _bytes_case_sse2(ptr, len, from, to);
+    #endif
+    _bytes_case_scalar(ptr + done, len - done, from, to);
+}
+
+void bytes_upper(char *ptr, size_t len)
+{
+    _bytes_case(ptr, len, 'a', 'z');
+}
+
+void bytes_lower(char *ptr, size_t len)
+{
+    _bytes_case(ptr, len, 'A', 'Z');
+}
+
+void bytes_reverse(char *ptr, size_t len)
+{
+    if (len < 2) return;
+    size_t done = 0;
+    #ifdef PCT_BYTES_X86
+    int level = bytes_simd_level();
+    if (level == BYTES_LEVEL_AVX2) done = _bytes_reverse_avx2(ptr, len);
+    else if (level == BYTES_LEVEL_SSE2) done = _bytes_reverse_sse2(ptr, len);
+    #endif
+    _bytes_reverse_scalar(ptr + done, ptr + len - done - 1);
+}
+
+size_t bytes_count(const char *ptr, size_t len, char c)
+{
+    size_t count = 0;
+    size_t done = 0;
+    #ifdef PCT_BYTES_X86
+    int level = bytes_simd_level();
+    if (level == BYTES_LEVEL_AVX2) done = _bytes_count_avx2(ptr, len, c, &count);
+    else if (level == BYTES_LEVEL_SSE2) done = _bytes_count_sse2(ptr, len, c, &count);
+    #endif
+    for (size_t i = done; i < len; i++) {
+        if (ptr[i] == c) count++;
+    }
+    return count;
+}
+
+bool bytes_is_class(char c, int cls)
+{
+    return _bytes_is_class((unsigned char)c, cls);
+}
+
+// index of the first byte that is (isMember) or is not (!isMember) in cls, len if none
+size_t bytes_scan(const char *ptr, size_t len, int cls, bool isMember)
+{
+    size_t done = 0;
+    size_t found = len;
+    #ifdef PCT_BYTES_X86
+    int level = bytes_simd_level();
+    if (level == BYTES_LEVEL_AVX2) done = _bytes_scan_avx2(ptr, len, cls, isMember, &found);
+    else if (level == BYTES_LEVEL_SSE2) done = _bytes_scan_sse2(ptr, len, cls, isMember, &found);
+    if (found != len) return found;
+    #endif
+    for (size_t i = done; i < len; i++) {
+        if (_bytes_is_class((unsigned char)ptr[i], cls) == isMember) return i;
+    }
+    return len;
+}
+
+// index of the last byte that is (isMember) or is not (!isMember) in cls, -1 if none
+long bytes_scan_back(const char *ptr, size_t len, int cls, bool isMember)
+{
+    size_t done = 0;
+    size_t found = len;
+    #ifdef PCT_BYTES_X86
+    int level = bytes_simd_level();
+    if (level == BYTES_LEVEL_AVX2) done = _bytes_scan_back_avx2(ptr, len, cls, isMember, &found);
+    else if (level == BYTES_LEVEL_SSE2) done = _bytes_scan_back_sse2(ptr, len, cls, isMember, &found);
+    if (found != len) return found;
+    #endif
+    for (size_t i = len - done; i > 0; i--) {
+        if (_bytes_is_class((unsigned char)ptr[i - 1], cls) == isMember) return i - 1;
+    }
+    return -1;
+}
+
+#endif
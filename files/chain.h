@@ -15,7 +15,7 @@ typedef struct _Chain {
     bool retain;
 } Chain;
 
-Chain *_Chain_new(bool isRetain, int size, char typ) {
+Chain *_Chain_new(bool isRetain, int size, int typ) {
     Chain *chain = (Chain *)pct_mallloc(size);
     Object_init(chain, typ);
     chain->size = 0;
@@ -244,20 +244,121 @@ Chain *Chain_clone(Chain *this) {
     return chain;
 }
 
+// in place, every block swaps its links, cursors keep pointing at the same blocks
 void Chain_reverse(Chain *this)
 {
-    Chain *chain = Chain_clone(this);
-    chain->retain = false;
-    Chain_clear_from_head(this);
-    Chain_RESTE_TO_TAIL(chain);
-    void *data = Chain_LAST(chain);
-    while (data != NULL)
+    Block *current = this->head;
+    while (current != NULL)
+    {
+        Block *next = current->next;
+        current->next = current->last;
+        current->last = next;
+        current = next;
+    }
+    Block *head = this->head;
+    this->head = this->tail;
+    this->tail = head;
+}
+
+// values moving between a retaining and a non retaining chain gain or lose their reference
+void _Chain_adopt(Chain *this, Chain *other, Block *first, Block *last)
+{
+    if (this->retain == other->retain) return;
+    for (Block *block = first; block != NULL; block = block == last ? NULL : block->next)
+    {
+        if (this->retain) {
+            Object_retain(block->data);
+        } else {
+            Object_release(block->data);
+        }
+    }
+}
+
+// moves the blocks first..last of other, both included, behind at in this without copying,
+// a NULL at puts them in front, first must not come after last,
+// nothing moves when other is this and at lies inside first..last,
+// costs one walk over the moved range to count it
+void Chain_splice(Chain *this, Block *at, Chain *other, Block *first, Block *last)
+{
+    if (first == NULL || last == NULL) return;
+    int count = 0;
+    bool hasCursor = false;
+    for (Block *block = first; block != NULL; block = block == last ? NULL : block->next)
     {
-        Chain_push_to_tail(this, data);
-        data = Chain_LAST(chain);
+        if (other == this && block == at) return;
+        if (Cursor_get(other->cursor) == block) hasCursor = true;
+        count++;
+    }
+    // moved inside one chain a cursor stays on its block, like Chain_reverse leaves it
+    if (hasCursor && other != this) Cursor_set(other->cursor, NULL);
+    _Chain_adopt(this, other, first, last);
+    // unlink from other
+    Block *before = first->last;
+    Block *after = last->next;
+    if (before != NULL) {
+        before->next = after;
+    } else {
+        other->head = after;
+    }
+    if (after != NULL) {
+        after->last = before;
+    } else {
+        other->tail = before;
+    }
+    other->size -= count;
+    // link into this
+    Block *next = at != NULL ? at->next : this->head;
+    first->last = at;
+    last->next = next;
+    if (at != NULL) {
+        at->next = first;
+    } else {
+        this->head = first;
+    }
+    if (next != NULL) {
+        next->last = last;
+    } else {
+        this->tail = last;
+    }
+    this->size += count;
+}
+
+// moves every block of other to the end of this in O(1), other is left empty
+void Chain_concat(Chain *this, Chain *other)
+{
+    if (other == this || other->head == NULL) return;
+    _Chain_adopt(this, other, other->head, other->tail);
+    if (this->tail != NULL) {
+        Block_link(this->tail, other->head);
+    } else {
+        this->head = other->head;
     }
-    Chain_RESTE_TO_HEAD(chain);
-    Object_release(chain);
+    this->tail = other->tail;
+    this->size += other->size;
+    other->head = NULL;
+    other->tail = NULL;
+    other->size = 0;
+    Cursor_set(other->cursor, NULL);
+}
+
+// unlinks the block under the cursor, the one Chain_next or Chain_last would return,
+// and moves the cursor past it in the walking direction, forward for Chain_next,
+// returns its value, released like a pop does
+void *Chain_removeAtCursor(Chain *this, Cursor *cursor, bool isForward)
+{
+    Block *block = Cursor_get(cursor);
+    if (block == NULL) return NULL;
+    Block *next = isForward ? block->next : block->last;
+    Cursor_set(cursor, next);
+    if (Cursor_get(this->cursor) == block) Cursor_set(this->cursor, next);
+    if (this->head == block) this->head = block->next;
+    if (this->tail == block) this->tail = block->last;
+    Block_remove(block);
+    this->size--;
+    void *data = block->data;
+    if (this->retain) Object_release(data);
+    Object_release(block);
+    return data;
 }
 
 typedef void (*CHAIN_FOREACH_FUNC)(void *, void *);
@@ -144,20 +144,15 @@ int64_t strint( const char *string ) { $
 // - rlyeh, public domain.
 
 char *strlower(char *string) {
-    if( string ) for( char *s = string; *s; ++s ) *s = tolower(*s);
+    if( string ) bytes_lower(string, strlen(string));
     return string;
 }
 char *strupper(char *string) {
-    if( string ) for( char *s = string; *s; ++s ) *s = toupper(*s);
+    if( string ) bytes_upper(string, strlen(string));
     return string;
 } 
 char *strrev(char *string) {
-    if(string && *string)
-    for( char *p1 = string, *p2 = p1 + strlen(p1) - 1; p2 > p1; ++p1, --p2 ) {
-        *p1 ^= *p2;
-        *p2 ^= *p1;
-        *p1 ^= *p2;
-    }
+    if( string ) bytes_reverse(string, strlen(string));
     return string;
 }
 char *strdel(char *string, const char *substring) {
@@ -10,8 +10,7 @@ typedef struct _Cursor {
 
 Cursor *Cursor_new(void *target)
 {
-    Cursor *cursor = (Cursor *)pct_mallloc(sizeof(Cursor));
-    Object_init(cursor, PCT_OBJ_CURSOR);
+    Cursor *cursor = (Cursor *)Object_newPooled(sizeof(Cursor), PCT_OBJ_CURSOR);
     cursor->target = target;
     return cursor;
 }
@@ -20,8 +20,7 @@ void Foliage_init(void *_foliage, void *data)
 
 Foliage *Foliage_new(void *data)
 {
-    Foliage *foliage = (Foliage *)pct_mallloc(sizeof(Foliage));
-    Object_init(foliage, PCT_OBJ_FOLIAGE);
+    Foliage *foliage = (Foliage *)Object_newPooled(sizeof(Foliage), PCT_OBJ_FOLIAGE);
     Foliage_init(foliage, data);
     return foliage;
 }
@@ -3,135 +3,1136 @@
 #ifndef H_PCT_GALLECTOR
 #define H_PCT_GALLECTOR
 
-typedef Object* (*GACHE_CREATE_FUNC)(void *);
-typedef Object* (*GACHE_FREE_FUNC)(void *);
+#include <stdatomic.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// gcNext only chains objects resting in a Gache, the Gallector keeps its own segments
+typedef struct _GcObject {
+    struct _Object;
+    struct _GcObject *gcNext;
+} GcObject;
+
+typedef GcObject* (*GACHE_CREATE_FUNC)(void *);
+typedef GcObject* (*GACHE_FREE_FUNC)(void *);
+
+// a collection cycle goes idle -> mark -> sweep -> idle, each phase can run in steps
+#define GALLECTOR_IDLE 0
+#define GALLECTOR_MARK 1
+#define GALLECTOR_SWEEP 2
+
+// a minor cycle only collects the young list, old objects count as alive
+#define GALLECTOR_MINOR 1
+#define GALLECTOR_MAJOR 2
+
+// clock is read once every this many objects while a step has a time budget
+#define GALLECTOR_CLOCK_STRIDE 32
+// young objects move to the old list after surviving this many sweeps
+#define GALLECTOR_PROMOTE_AGE 2
+// tracked objects are kept in chunks of this many pointers, a chunk is the unit of parallel sweeping
+#define GALLECTOR_SEGMENT_SIZE 1024
+#define GALLECTOR_MAX_THREADS 64
+// objects a Gache moves from or to its depot at once
+#define GACHE_BATCH 32
+
+typedef struct _GcSegment {
+    struct _GcSegment *next;
+    int count;
+    GcObject *objects[GALLECTOR_SEGMENT_SIZE];
+} GcSegment;
+
+typedef struct _GcList {
+    GcSegment *head;
+    GcSegment *tail;
+} GcList;
 
+// every creator gets one depot shared by its Gaches, it holds at most the sum of their sizes,
+// low water marks remember how many objects sat unused since the last trim
+typedef struct _GcDepot {
+    atomic_flag lock;
+    GACHE_CREATE_FUNC creator;
+    GcObject *cache;
+    int count;
+    int limit;
+    int lowWater;
+} GcDepot;
+
+struct _Gallector;
+struct _Gache;
+typedef void (*GALLECTOR_TRACE_FUNC)(struct _Gallector *, GcObject *);
+
+// young and old are the two generations,
+// remembered lists old objects that were given a young child
 typedef struct _Gallector {
     struct _Object;
-    Object* first;
+    GcList young;
+    GcList old;
     int numObjects;
     int maxObjects;
+    int numYoung;
+    int maxYoung;
     size_t extra;
     GACHE_FREE_FUNC freeer;
+    GALLECTOR_TRACE_FUNC tracer;
+    int phase;
+    int kind;
+    int promoteAge;
+    GcObject **grays;
+    int grayCount;
+    int grayCapacity;
+    GcObject **remembered;
+    int rememberedCount;
+    int rememberedCapacity;
+    bool probing;
+    bool probeHit;
+    bool sweepOld;
+    bool sweepStarted;
+    GcSegment *sweepSegment;
+    GcSegment *sweepPrevious;
+    int sweepRead;
+    int sweepWrite;
+    int sweepFreed;
+    GcDepot **depots;
+    int depotCount;
+    struct _Gache **gaches;
+    int gacheCount;
+    int gacheCapacity;
 } Gallector;
 
 typedef struct _Gache {
     struct _Object;
     Object *gallector;
     size_t size;
-    Object *cache;
+    GcObject *cache;
+    int count;
+    int lowWater;
+    GcDepot *depot;
     GACHE_CREATE_FUNC creator;
+    size_t hits;
+    size_t misses;
+    size_t refills;
+    size_t flushes;
 } Gache;
 
 Gallector *Gallector_new(size_t extra, GACHE_FREE_FUNC freeer)
 {
     Gallector *gallector = (Gallector *)pct_mallloc(sizeof(Gallector));
     Object_init(gallector, PCT_OBJ_GALLECTOR);
-    gallector->first = NULL;
+    gallector->young.head = NULL;
+    gallector->young.tail = NULL;
+    gallector->old.head = NULL;
+    gallector->old.tail = NULL;
     gallector->numObjects = 0;
     gallector->maxObjects = 50;
+    gallector->numYoung = 0;
+    gallector->maxYoung = 50;
     gallector->extra = extra;
     gallector->freeer = freeer;
+    gallector->tracer = NULL;
+    gallector->phase = GALLECTOR_IDLE;
+    gallector->kind = GALLECTOR_MAJOR;
+    gallector->promoteAge = GALLECTOR_PROMOTE_AGE;
+    gallector->grays = NULL;
+    gallector->grayCount = 0;
+    gallector->grayCapacity = 0;
+    gallector->remembered = NULL;
+    gallector->rememberedCount = 0;
+    gallector->rememberedCapacity = 0;
+    gallector->probing = false;
+    gallector->probeHit = false;
+    gallector->sweepOld = false;
+    gallector->sweepStarted = false;
+    gallector->sweepSegment = NULL;
+    gallector->sweepPrevious = NULL;
+    gallector->sweepRead = 0;
+    gallector->sweepWrite = 0;
+    gallector->sweepFreed = 0;
+    gallector->depots = NULL;
+    gallector->depotCount = 0;
+    gallector->gaches = NULL;
+    gallector->gacheCount = 0;
+    gallector->gacheCapacity = 0;
     return gallector;
 }
 
+GcDepot *_gallector_depot(Gallector *this, GACHE_CREATE_FUNC func)
+{
+    for (int i = 0; i < this->depotCount; i++) {
+        if (this->depots[i]->creator == func) return this->depots[i];
+    }
+    GcDepot *depot = pct_mallloc(sizeof(GcDepot));
+    atomic_flag_clear(&depot->lock);
+    depot->creator = func;
+    depot->cache = NULL;
+    depot->count = 0;
+    depot->limit = 0;
+    depot->lowWater = 0;
+    this->depots = pct_realloc(this->depots, sizeof(GcDepot *) * (this->depotCount + 1));
+    this->depots[this->depotCount++] = depot;
+    return depot;
+}
+
+// caches made with the same creator recycle objects through one depot,
+// size is how many objects this one keeps at hand, 0 keeps none
 Gache *Gallector_cache(Gallector *this, size_t size, GACHE_CREATE_FUNC func)
 {
     Gache *gache = (Gache *)pct_mallloc(sizeof(Gache));
-    Object_init(gache, PCT_OBJ_OBJECT);
+    Object_init(gache, PCT_OBJ_GACHE);
     gache->gallector = (Object *)this;
     gache->size = size;
     gache->cache = NULL;
+    gache->count = 0;
+    gache->lowWater = 0;
+    gache->depot = _gallector_depot(this, func);
+    gache->depot->limit += size;
     gache->creator = func;
+    gache->hits = 0;
+    gache->misses = 0;
+    gache->refills = 0;
+    gache->flushes = 0;
+    if (this->gacheCount == this->gacheCapacity) {
+        this->gacheCapacity = this->gacheCapacity > 0 ? this->gacheCapacity * 2 : 8;
+        this->gaches = pct_realloc(this->gaches, sizeof(Gache *) * this->gacheCapacity);
+    }
+    this->gaches[this->gacheCount++] = gache;
     return gache;
 }
 
-Object *Gache_get(Gache *this, bool freeze)
+// creators allocate as they like and the freeer releases, so the object is not tracked
+void GcObject_init(void *_this, int _objType)
+{
+    GcObject *this = _this;
+    _object_setup((Object *)this, _objType, 0, false);
+    this->gcNext = NULL;
+}
+
+bool GcObject_isMarked(void *_this)
+{
+    return Object_hasFlag(_this, OBJECT_FLAG_MARK);
+}
+
+void GcObject_setMark(void *_this, bool isMarked)
+{
+    Object_setFlag(_this, OBJECT_FLAG_MARK, isMarked);
+}
+
+bool GcObject_isFrozen(void *_this)
+{
+    return Object_hasFlag(_this, OBJECT_FLAG_FREEZE);
+}
+
+void GcObject_setFreeze(void *_this, bool isFrozen)
+{
+    Object_setFlag(_this, OBJECT_FLAG_FREEZE, isFrozen);
+}
+
+bool GcObject_isOld(void *_this)
+{
+    return Object_hasFlag(_this, OBJECT_FLAG_OLD);
+}
+
+int GcObject_age(void *_this)
 {
-    Object *object = this->cache;
+    return (((Object *)_this)->objFlags & OBJECT_AGE_MASK) >> OBJECT_AGE_SHIFT;
+}
+
+void _gcobject_set_age(GcObject *this, int age)
+{
+    age = MIN(age, OBJECT_AGE_MASK >> OBJECT_AGE_SHIFT);
+    Object *object = (Object *)this;
+    object->objFlags = (object->objFlags & ~OBJECT_AGE_MASK) | (age << OBJECT_AGE_SHIFT);
+}
+
+// tri-color: white is unmarked, gray is marked and waiting to be traced, black is marked and traced
+bool GcObject_isWhite(void *_this)
+{
+    return !GcObject_isMarked(_this);
+}
+
+bool GcObject_isBlack(void *_this)
+{
+    return GcObject_isMarked(_this) && !Object_hasFlag(_this, OBJECT_FLAG_GRAY);
+}
+
+// appends at the tail, a sweep in progress always reaches it later
+void _gclist_push(GcList *list, GcObject *object)
+{
+    GcSegment *segment = list->tail;
+    if (segment == NULL || segment->count == GALLECTOR_SEGMENT_SIZE) {
+        segment = pct_mallloc(sizeof(GcSegment));
+        segment->next = NULL;
+        segment->count = 0;
+        if (list->tail != NULL) {
+            list->tail->next = segment;
+        } else {
+            list->head = segment;
+        }
+        list->tail = segment;
+    }
+    segment->objects[segment->count++] = object;
+}
+
+// unlinks a segment a sweep left empty
+GcSegment *_gclist_drop(GcList *list, GcSegment *previous, GcSegment *segment)
+{
+    GcSegment *next = segment->next;
+    if (previous != NULL) {
+        previous->next = next;
+    } else {
+        list->head = next;
+    }
+    if (list->tail == segment) list->tail = previous;
+    pct_free(segment);
+    return next;
+}
+
+void _gclist_clear(GcList *list)
+{
+    GcSegment *segment = list->head;
+    while (segment != NULL) {
+        GcSegment *next = segment->next;
+        pct_free(segment);
+        segment = next;
+    }
+    list->head = NULL;
+    list->tail = NULL;
+}
+
+int _gclist_segments(GcList *list)
+{
+    int count = 0;
+    for (GcSegment *segment = list->head; segment != NULL; segment = segment->next) count++;
+    return count;
+}
+
+void _gcdepot_lock(GcDepot *depot)
+{
+    while (atomic_flag_test_and_set_explicit(&depot->lock, memory_order_acquire)) {}
+}
+
+void _gcdepot_unlock(GcDepot *depot)
+{
+    atomic_flag_clear_explicit(&depot->lock, memory_order_release);
+}
+
+// cuts the first count objects off a chain, returns the rest
+GcObject *_gache_split(GcObject *head, int count, GcObject **last)
+{
+    GcObject *object = head;
+    for (int i = 1; i < count; i++) object = object->gcNext;
+    *last = object;
+    GcObject *rest = object->gcNext;
+    object->gcNext = NULL;
+    return rest;
+}
+
+void _gache_refill(Gache *this)
+{
+    GcDepot *depot = this->depot;
+    if (depot == NULL || this->size == 0) return;
+    _gcdepot_lock(depot);
+    int count = MIN(depot->count, MIN(GACHE_BATCH, (int)this->size));
+    if (count > 0) {
+        GcObject *head = depot->cache;
+        GcObject *last;
+        depot->cache = _gache_split(head, count, &last);
+        depot->count -= count;
+        depot->lowWater = MIN(depot->lowWater, depot->count);
+        last->gcNext = this->cache;
+        this->cache = head;
+        this->count += count;
+        this->refills++;
+    }
+    _gcdepot_unlock(depot);
+}
+
+// moves up to count objects to the depot, it takes no more than its limit
+void _gache_flush(Gache *this, int count, bool force)
+{
+    GcDepot *depot = this->depot;
+    if (depot == NULL) return;
+    _gcdepot_lock(depot);
+    if (!force) count = MIN(count, depot->limit - depot->count);
+    count = MIN(count, this->count);
+    if (count > 0) {
+        GcObject *head = this->cache;
+        GcObject *last;
+        this->cache = _gache_split(head, count, &last);
+        this->count -= count;
+        this->lowWater = MIN(this->lowWater, this->count);
+        last->gcNext = depot->cache;
+        depot->cache = head;
+        depot->count += count;
+        this->flushes++;
+    }
+    _gcdepot_unlock(depot);
+}
+
+GcObject *Gache_get(Gache *this, bool freeze)
+{
+    if (this->cache == NULL) _gache_refill(this);
+    GcObject *object = this->cache;
     if (object) {
         this->cache = object->gcNext;
+        this->count--;
+        this->lowWater = MIN(this->lowWater, this->count);
+        this->hits++;
     } else {
         object = this->creator(this);
+        this->misses++;
     }
-    object->gcCount = 0;
+    ((Object *)object)->gcCount = 0;
     object->gcNext = NULL;
-    // 
+    //
     Gallector *gallector = (Gallector *)this->gallector;
-    object->gcFreeze = freeze;
-    if (!freeze) {
-        object->gcNext = gallector->first;
-        gallector->first = object;
+    GcObject_setFreeze(object, freeze);
+    Object_setFlag(object, OBJECT_FLAG_OLD | OBJECT_FLAG_REMEMBERED | OBJECT_FLAG_GRAY | OBJECT_AGE_MASK, false);
+    // born black while a cycle runs, the sweep reaches every new object and whitens it,
+    // white otherwise so the next cycle starts clean
+    GcObject_setMark(object, gallector != NULL && gallector->phase != GALLECTOR_IDLE);
+    // a cache outliving its gallector only creates, nothing tracks the object anymore
+    if (!freeze && gallector != NULL) {
+        _gclist_push(&gallector->young, object);
         gallector->numObjects++;
+        gallector->numYoung++;
     }
-    // 
+    //
     return object;
 }
 
-bool Gache_return(Gache *this, Object *object) {
-    if (this->cache) {
-        int count = (this->cache)->gcCount;
-        if (count >= this->size) {
-            return false;
+// false when the cache and its depot are both full or the gallector is gone, the caller frees the object then
+bool Gache_return(Gache *this, GcObject *object) {
+    if (this->gallector == NULL) return false;
+    if (this->count >= (int)this->size) _gache_flush(this, this->count - (int)this->size / 2, false);
+    if (this->count >= (int)this->size) return false;
+    ((Object *)object)->gcCount = 0;
+    object->gcNext = this->cache;
+    this->cache = object;
+    this->count++;
+    return true;
+}
+
+// frees objects the depot is not allowed to keep anymore plus half of the ones that stayed unused
+void _gcdepot_trim(Gallector *this, GcDepot *depot)
+{
+    _gcdepot_lock(depot);
+    int count = MIN(depot->count, MAX(depot->count - depot->limit, (depot->lowWater + 1) / 2));
+    GcObject *head = NULL;
+    if (count > 0) {
+        GcObject *last;
+        head = depot->cache;
+        depot->cache = _gache_split(head, count, &last);
+        depot->count -= count;
+    }
+    depot->lowWater = depot->count;
+    _gcdepot_unlock(depot);
+    while (head != NULL) {
+        GcObject *next = head->gcNext;
+        head->gcNext = NULL;
+        this->freeer(head);
+        head = next;
+    }
+}
+
+// an idle cache hands half of its unused objects back, the depot frees half of its own,
+// so memory held for a burst drains away over a few trims
+void Gache_trim(Gache *this)
+{
+    _gache_flush(this, (this->lowWater + 1) / 2, true);
+    this->lowWater = this->count;
+}
+
+// runs at the end of every cycle, call it by hand from idle frames too,
+// no Gache may be in use on another thread meanwhile
+void Gallector_trim(Gallector *this)
+{
+    for (int i = 0; i < this->gacheCount; i++) Gache_trim(this->gaches[i]);
+    for (int i = 0; i < this->depotCount; i++) _gcdepot_trim(this, this->depots[i]);
+}
+
+void Gache_print(Gache *this)
+{
+    size_t total = this->hits + this->misses;
+    double rate = total > 0 ? 100.0 * this->hits / total : 0;
+    printf("[(GACHE) => p:%p, c:%d, h:%zu, m:%zu, r:%.1f%%]\n", this, this->count, this->hits, this->misses, rate);
+}
+
+// the cached objects go to the depot, it trims what it can not keep
+void Gache_free(Gache *this)
+{
+    Gallector *gallector = (Gallector *)this->gallector;
+    if (gallector != NULL) {
+        _gache_flush(this, this->count, true);
+        this->depot->limit -= this->size;
+        _gcdepot_trim(gallector, this->depot);
+        for (int i = 0; i < gallector->gacheCount; i++) {
+            if (gallector->gaches[i] != this) continue;
+            gallector->gaches[i] = gallector->gaches[--gallector->gacheCount];
+            break;
         }
-        object->gcCount = count + 1;
-        object->gcNext = this->cache;
     }
-    this->cache = object;
+    Object_free(this);
+}
+
+long long _gallector_now()
+{
+    #ifdef CLOCK_MONOTONIC
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+    #else
+    return (long long)clock() * (1000000000LL / CLOCKS_PER_SEC);
+    #endif
+}
+
+// 0 means no limit for either bound
+bool _gallector_over_budget(long long start, int done, int maxObjects, long long budgetNs)
+{
+    if (maxObjects > 0 && done >= maxObjects) return true;
+    if (budgetNs <= 0 || done % GALLECTOR_CLOCK_STRIDE != 0) return false;
+    return _gallector_now() - start >= budgetNs;
+}
+
+// called for every gray object, it should Gallector_shade each child,
+// parallel marks call it from several threads at once so it must only read
+void Gallector_setTracer(Gallector *this, GALLECTOR_TRACE_FUNC tracer)
+{
+    this->tracer = tracer;
+}
+
+int Gallector_phase(Gallector *this)
+{
+    return this->phase;
+}
+
+void Gallector_setPromoteAge(Gallector *this, int age)
+{
+    this->promoteAge = MAX(1, MIN(age, OBJECT_AGE_MASK >> OBJECT_AGE_SHIFT));
+}
+
+// GALLECTOR_MAJOR once the old list outgrew maxObjects, GALLECTOR_MINOR once the young one outgrew maxYoung, else 0
+int Gallector_due(Gallector *this)
+{
+    if (this->numObjects > this->maxObjects) return GALLECTOR_MAJOR;
+    if (this->numYoung > this->maxYoung) return GALLECTOR_MINOR;
+    return 0;
+}
+
+void _gallector_remember(Gallector *this, GcObject *object)
+{
+    if (Object_hasFlag(object, OBJECT_FLAG_REMEMBERED)) return;
+    Object_setFlag(object, OBJECT_FLAG_REMEMBERED, true);
+    if (this->rememberedCount == this->rememberedCapacity) {
+        this->rememberedCapacity = this->rememberedCapacity > 0 ? this->rememberedCapacity * 2 : 16;
+        this->remembered = pct_realloc(this->remembered, sizeof(GcObject *) * this->rememberedCapacity);
+    }
+    this->remembered[this->rememberedCount++] = object;
+}
+
+void _gallector_forget(Gallector *this, GcObject *object)
+{
+    if (!Object_hasFlag(object, OBJECT_FLAG_REMEMBERED)) return;
+    Object_setFlag(object, OBJECT_FLAG_REMEMBERED, false);
+    for (int i = 0; i < this->rememberedCount; i++) {
+        if (this->remembered[i] != object) continue;
+        this->remembered[i] = this->remembered[--this->rememberedCount];
+        return;
+    }
+}
+
+// parallel marking, every worker owns a gray stack the others steal from when they run dry,
+// pending counts gray objects not traced yet so the workers know when to stop
+struct _GcJob;
+
+typedef struct _GcWorker {
+    struct _GcJob *job;
+    int index;
+    atomic_flag lock;
+    GcObject **stack;
+    int count;
+    int capacity;
+    int freed;
+    int promoted;
+} GcWorker;
+
+typedef struct _GcJob {
+    Gallector *gallector;
+    GcWorker *workers;
+    int threads;
+    atomic_int pending;
+    GcSegment **segments;
+    int segmentCount;
+    bool isOld;
+    Gache **caches;
+} GcJob;
+
+PCT_THREAD_LOCAL GcWorker *_gallector_worker = NULL;
+
+#define _GCOBJECT_ATOMIC_FLAGS(object) ((_Atomic unsigned short *)&((Object *)(object))->objFlags)
+
+void _gcworker_push(GcWorker *this, GcObject *object)
+{
+    while (atomic_flag_test_and_set_explicit(&this->lock, memory_order_acquire)) {}
+    if (this->count == this->capacity) {
+        this->capacity = this->capacity > 0 ? this->capacity * 2 : 256;
+        this->stack = pct_allocator_libc.realloc(NULL, this->stack, sizeof(GcObject *) * this->capacity);
+    }
+    this->stack[this->count++] = object;
+    atomic_flag_clear_explicit(&this->lock, memory_order_release);
+}
+
+GcObject *_gcworker_pop(GcWorker *this)
+{
+    while (atomic_flag_test_and_set_explicit(&this->lock, memory_order_acquire)) {}
+    GcObject *object = this->count > 0 ? this->stack[--this->count] : NULL;
+    atomic_flag_clear_explicit(&this->lock, memory_order_release);
+    return object;
+}
+
+// the mark bit is claimed with a cas so every object is traced by exactly one worker
+void _gcworker_shade(GcWorker *this, GcObject *object)
+{
+    Gallector *gallector = this->job->gallector;
+    _Atomic unsigned short *flags = _GCOBJECT_ATOMIC_FLAGS(object);
+    unsigned short value = atomic_load_explicit(flags, memory_order_relaxed);
+    do {
+        if (value & OBJECT_FLAG_MARK) return;
+        if (gallector->kind == GALLECTOR_MINOR && (value & OBJECT_FLAG_OLD)) return;
+    } while (!atomic_compare_exchange_weak_explicit(flags, &value, value | OBJECT_FLAG_MARK | OBJECT_FLAG_GRAY, memory_order_acq_rel, memory_order_relaxed));
+    atomic_fetch_add_explicit(&this->job->pending, 1, memory_order_relaxed);
+    _gcworker_push(this, object);
+}
+
+// white -> gray, roots and traced children go through here, does nothing outside a mark,
+// a minor mark leaves old objects alone
+void Gallector_shade(Gallector *this, void *_object)
+{
+    GcObject *object = _object;
+    if (this->probing) {
+        if (object != NULL && !GcObject_isOld(object)) this->probeHit = true;
+        return;
+    }
+    if (this->phase != GALLECTOR_MARK || object == NULL) return;
+    if (_gallector_worker != NULL) {
+        _gcworker_shade(_gallector_worker, object);
+        return;
+    }
+    if (!GcObject_isWhite(object)) return;
+    if (this->kind == GALLECTOR_MINOR && GcObject_isOld(object)) return;
+    Object_setFlag(object, OBJECT_FLAG_MARK | OBJECT_FLAG_GRAY, true);
+    if (this->grayCount == this->grayCapacity) {
+        this->grayCapacity = this->grayCapacity > 0 ? this->grayCapacity * 2 : 64;
+        this->grays = pct_realloc(this->grays, sizeof(GcObject *) * this->grayCapacity);
+    }
+    this->grays[this->grayCount++] = object;
+}
+
+// call it after every store of child into parent:
+// old parents with a young child join the remembered set for minor cycles,
+// and while a mark is running a black parent must never point at a white child,
+// frozen or NULL parents count as roots, a minor mark takes old parents as black
+void Gallector_barrier(Gallector *this, void *parent, void *child)
+{
+    if (child == NULL) return;
+    bool isOldParent = parent != NULL && GcObject_isOld(parent);
+    if (isOldParent && !GcObject_isOld(child)) _gallector_remember(this, parent);
+    if (this->phase != GALLECTOR_MARK) return;
+    if (parent == NULL || GcObject_isFrozen(parent) || GcObject_isBlack(parent) || (isOldParent && this->kind == GALLECTOR_MINOR)) {
+        Gallector_shade(this, child);
+    }
+}
+
+#define GALLECTOR_WRITE(gallector, parent, field, value) do { \
+    (parent)->field = (value); \
+    Gallector_barrier((gallector), (parent), (parent)->field); \
+} while (0)
+
+void Gallector_sweepFinish(Gallector *this);
+
+void _gallector_begin(Gallector *this, int kind)
+{
+    if (this->phase == GALLECTOR_MARK) return;
+    if (this->phase == GALLECTOR_SWEEP) Gallector_sweepFinish(this);
+    this->phase = GALLECTOR_MARK;
+    this->kind = kind;
+    this->grayCount = 0;
+}
+
+// starts a major cycle, every object is white here, shade the roots right after
+void Gallector_markBegin(Gallector *this)
+{
+    _gallector_begin(this, GALLECTOR_MAJOR);
+}
+
+// starts a minor cycle, the remembered old objects are traced as extra roots
+void Gallector_minorBegin(Gallector *this)
+{
+    _gallector_begin(this, GALLECTOR_MINOR);
+    if (this->tracer == NULL) return;
+    for (int i = 0; i < this->rememberedCount; i++) this->tracer(this, this->remembered[i]);
+}
+
+// drops remembered objects that no longer hold a young child
+void _gallector_prune(Gallector *this)
+{
+    if (this->tracer == NULL) return;
+    this->probing = true;
+    for (int i = 0; i < this->rememberedCount; ) {
+        GcObject *object = this->remembered[i];
+        this->probeHit = false;
+        this->tracer(this, object);
+        if (this->probeHit) {
+            i++;
+            continue;
+        }
+        Object_setFlag(object, OBJECT_FLAG_REMEMBERED, false);
+        this->remembered[i] = this->remembered[--this->rememberedCount];
+    }
+    this->probing = false;
+}
+
+void _gallector_sweep_seek(Gallector *this, bool isOld)
+{
+    this->sweepOld = isOld;
+    this->sweepSegment = isOld ? this->old.head : this->young.head;
+    this->sweepPrevious = NULL;
+    this->sweepRead = 0;
+    this->sweepWrite = 0;
+}
+
+void _gallector_sweep_begin(Gallector *this)
+{
+    this->phase = GALLECTOR_SWEEP;
+    // old list first, objects promoted by the young sweep must not be visited again
+    _gallector_sweep_seek(this, this->kind == GALLECTOR_MAJOR);
+    this->sweepStarted = false;
+    this->sweepFreed = 0;
+}
+
+void _gallector_sweep_end(Gallector *this)
+{
+    this->phase = GALLECTOR_IDLE;
+    this->sweepSegment = NULL;
+    this->sweepPrevious = NULL;
+    _gallector_prune(this);
+    this->maxYoung = this->numYoung * 2 + this->extra;
+    if (this->kind == GALLECTOR_MAJOR) this->maxObjects = this->numObjects * 2 + this->extra;
+    this->kind = GALLECTOR_MAJOR;
+    Gallector_trim(this);
+}
+
+// returns true once nothing is gray anymore, the sweep phase starts then
+bool Gallector_markStep(Gallector *this, int maxObjects, long long budgetNs)
+{
+    if (this->phase != GALLECTOR_MARK) return true;
+    long long start = budgetNs > 0 ? _gallector_now() : 0;
+    int done = 0;
+    while (this->grayCount > 0) {
+        GcObject *object = this->grays[--this->grayCount];
+        Object_setFlag(object, OBJECT_FLAG_GRAY, false);
+        if (this->tracer != NULL) this->tracer(this, object);
+        done++;
+        if (_gallector_over_budget(start, done, maxObjects, budgetNs)) break;
+    }
+    if (this->grayCount > 0) return false;
+    _gallector_sweep_begin(this);
     return true;
 }
 
-int Gallector_sweep(Gallector *this)
+#define _GALLECTOR_KEEP 0
+#define _GALLECTOR_PROMOTE 1
+#define _GALLECTOR_RELEASE 2
+
+// whitens survivors and ages the young ones, only touches the object itself
+int _gallector_judge(Gallector *this, GcObject *object, bool isOld)
+{
+    bool isFrozen = GcObject_isFrozen(object);
+    if (!GcObject_isMarked(object) && !isFrozen) return _GALLECTOR_RELEASE;
+    GcObject_setMark(object, false);
+    if (isOld || isFrozen) return _GALLECTOR_KEEP;
+    _gcobject_set_age(object, GcObject_age(object) + 1);
+    return GcObject_age(object) >= this->promoteAge ? _GALLECTOR_PROMOTE : _GALLECTOR_KEEP;
+}
+
+void _gallector_promote(Gallector *this, GcObject *object)
+{
+    Object_setFlag(object, OBJECT_FLAG_OLD, true);
+    _gclist_push(&this->old, object);
+    this->numYoung--;
+    // its young children were stored before it got old, the prune drops it if there are none
+    if (this->tracer != NULL) _gallector_remember(this, object);
+}
+
+void _gallector_release(Gallector *this, GcObject *object, bool isOld)
+{
+    _gallector_forget(this, object);
+    object->gcNext = NULL;
+    ((Object *)object)->gcCount = 0;
+    this->freeer(object);
+    this->numObjects--;
+    if (!isOld) this->numYoung--;
+    this->sweepFreed++;
+}
+
+// a visited segment keeps its survivors packed at the front, empty ones are dropped
+void _gallector_sweep_close(Gallector *this)
+{
+    GcList *list = this->sweepOld ? &this->old : &this->young;
+    GcSegment *segment = this->sweepSegment;
+    segment->count = this->sweepWrite;
+    if (segment->count == 0) {
+        this->sweepSegment = _gclist_drop(list, this->sweepPrevious, segment);
+    } else {
+        this->sweepPrevious = segment;
+        this->sweepSegment = segment->next;
+    }
+    this->sweepRead = 0;
+    this->sweepWrite = 0;
+}
+
+// frees unmarked objects from the saved cursor on, returns true when the cycle is over,
+// outside of a mark it sweeps with whatever marks were set by hand
+bool Gallector_sweepStep(Gallector *this, int maxObjects, long long budgetNs)
 {
-    int bgnCount = this->numObjects;
-    Object* previous = NULL;
-    Object* object = this->first;
-    while (object) {
-        if (object->gcMark || object->gcFreeze) {
-            object->gcMark = 0;
-            previous = object;
-            object = object->gcNext;
+    if (this->phase == GALLECTOR_MARK) return false;
+    if (this->phase == GALLECTOR_IDLE) _gallector_sweep_begin(this);
+    long long start = budgetNs > 0 ? _gallector_now() : 0;
+    int done = 0;
+    while (true) {
+        GcSegment *segment = this->sweepSegment;
+        if (segment == NULL) {
+            if (!this->sweepOld) break;
+            _gallector_sweep_seek(this, false);
             continue;
         }
-        //
-        Object* unreached = object;
-        object = unreached->gcNext;
-        if (previous != NULL) {
-            previous->gcNext = object;
+        // objects born during the sweep land at the tail and are read here too
+        if (this->sweepRead >= segment->count) {
+            _gallector_sweep_close(this);
+            continue;
+        }
+        GcObject *object = segment->objects[this->sweepRead++];
+        int verdict = _gallector_judge(this, object, this->sweepOld);
+        if (verdict == _GALLECTOR_KEEP) {
+            segment->objects[this->sweepWrite++] = object;
+        } else if (verdict == _GALLECTOR_PROMOTE) {
+            _gallector_promote(this, object);
         } else {
-            this->first = object;
+            _gallector_release(this, object, this->sweepOld);
         }
-        //
-        unreached->gcNext = NULL;
-        unreached->gcCount = 0;
-        this->freeer(unreached);
-        this->numObjects--;
+        this->sweepStarted = true;
+        done++;
+        if (_gallector_over_budget(start, done, maxObjects, budgetNs)) break;
+    }
+    if (this->sweepSegment != NULL || this->sweepOld) return false;
+    _gallector_sweep_end(this);
+    return true;
+}
+
+void Gallector_sweepFinish(Gallector *this)
+{
+    while (!Gallector_sweepStep(this, 0, 0)) {}
+}
+
+// runs the current phase for one tick, returns true when a whole cycle has completed
+bool Gallector_step(Gallector *this, int maxObjects, long long budgetNs)
+{
+    if (this->phase == GALLECTOR_MARK) {
+        Gallector_markStep(this, maxObjects, budgetNs);
+        return false;
+    }
+    if (this->phase == GALLECTOR_SWEEP) return Gallector_sweepStep(this, maxObjects, budgetNs);
+    return true;
+}
+
+// finishes the running cycle, an idle gallector sweeps once with the marks set by hand
+int _gallector_collect(Gallector *this, int kind)
+{
+    if (this->phase == GALLECTOR_MARK) {
+        while (!Gallector_markStep(this, 0, 0)) {}
+    }
+    if (this->phase == GALLECTOR_IDLE) {
+        this->kind = kind;
+        Gallector_sweepStep(this, 0, 0);
+        return this->sweepFreed;
+    }
+    int freed = this->sweepFreed;
+    Gallector_sweepFinish(this);
+    return this->sweepFreed - freed;
+}
+
+int Gallector_sweepMinor(Gallector *this)
+{
+    return _gallector_collect(this, GALLECTOR_MINOR);
+}
+
+int Gallector_sweepMajor(Gallector *this)
+{
+    return _gallector_collect(this, GALLECTOR_MAJOR);
+}
+
+int Gallector_sweep(Gallector *this)
+{
+    return _gallector_collect(this, GALLECTOR_MAJOR);
+}
+
+// the calling thread is worker 0, on windows everything stays on it
+void _gallector_run(GcJob *job, void *(*func)(void *))
+{
+    #ifndef _WIN32
+    pthread_t threads[GALLECTOR_MAX_THREADS];
+    for (int i = 1; i < job->threads; i++) pthread_create(&threads[i], NULL, func, &job->workers[i]);
+    func(&job->workers[0]);
+    for (int i = 1; i < job->threads; i++) pthread_join(threads[i], NULL);
+    #else
+    for (int i = 0; i < job->threads; i++) func(&job->workers[i]);
+    #endif
+}
+
+void _gallector_job_init(GcJob *job, Gallector *this, GcWorker *workers, int threads)
+{
+    #ifdef _WIN32
+    threads = 1;
+    #endif
+    job->gallector = this;
+    job->workers = workers;
+    job->threads = MAX(1, MIN(threads, GALLECTOR_MAX_THREADS));
+    atomic_init(&job->pending, 0);
+    job->segments = NULL;
+    job->segmentCount = 0;
+    job->isOld = false;
+    job->caches = NULL;
+    for (int i = 0; i < job->threads; i++) {
+        workers[i].job = job;
+        workers[i].index = i;
+        atomic_flag_clear(&workers[i].lock);
+        workers[i].stack = NULL;
+        workers[i].count = 0;
+        workers[i].capacity = 0;
+        workers[i].freed = 0;
+        workers[i].promoted = 0;
     }
-    //
-    int endCount = this->numObjects;
-    int delCount = bgnCount - endCount;
-    this->maxObjects = endCount * 2 + this->extra;
-    return delCount;
+}
+
+void *_gallector_mark_worker(void *data)
+{
+    GcWorker *worker = data;
+    GcJob *job = worker->job;
+    Gallector *gallector = job->gallector;
+    _gallector_worker = worker;
+    while (atomic_load_explicit(&job->pending, memory_order_acquire) > 0) {
+        GcObject *object = _gcworker_pop(worker);
+        for (int i = 1; object == NULL && i < job->threads; i++) {
+            object = _gcworker_pop(&job->workers[(worker->index + i) % job->threads]);
+        }
+        if (object == NULL) continue;
+        atomic_fetch_and_explicit(_GCOBJECT_ATOMIC_FLAGS(object), (unsigned short)~OBJECT_FLAG_GRAY, memory_order_relaxed);
+        if (gallector->tracer != NULL) gallector->tracer(gallector, object);
+        atomic_fetch_sub_explicit(&job->pending, 1, memory_order_acq_rel);
+    }
+    _gallector_worker = NULL;
+    return NULL;
+}
+
+// drains the gray objects on several threads, the mutator must be paused meanwhile
+void Gallector_markParallel(Gallector *this, int threads)
+{
+    if (this->phase != GALLECTOR_MARK) return;
+    GcWorker workers[GALLECTOR_MAX_THREADS];
+    GcJob job;
+    _gallector_job_init(&job, this, workers, threads);
+    for (int i = 0; i < this->grayCount; i++) _gcworker_push(&workers[i % job.threads], this->grays[i]);
+    atomic_store(&job.pending, this->grayCount);
+    this->grayCount = 0;
+    _gallector_run(&job, _gallector_mark_worker);
+    for (int i = 0; i < job.threads; i++) pct_allocator_libc.free(NULL, workers[i].stack);
+    _gallector_sweep_begin(this);
+}
+
+// segments are dealt round robin instead of stolen, so the same worker always frees the same objects
+void *_gallector_sweep_worker(void *data)
+{
+    GcWorker *worker = data;
+    GcJob *job = worker->job;
+    Gallector *gallector = job->gallector;
+    Gache *cache = job->caches != NULL ? job->caches[worker->index] : NULL;
+    for (int i = worker->index; i < job->segmentCount; i += job->threads) {
+        GcSegment *segment = job->segments[i];
+        int write = 0;
+        for (int read = 0; read < segment->count; read++) {
+            GcObject *object = segment->objects[read];
+            int verdict = _gallector_judge(gallector, object, job->isOld);
+            if (verdict == _GALLECTOR_RELEASE) {
+                object->gcNext = NULL;
+                ((Object *)object)->gcCount = 0;
+                if (cache == NULL || !Gache_return(cache, object)) gallector->freeer(object);
+                worker->freed++;
+                continue;
+            }
+            // moved to the old list afterwards, in segment order
+            if (verdict == _GALLECTOR_PROMOTE) {
+                Object_setFlag(object, OBJECT_FLAG_OLD, true);
+                worker->promoted++;
+            }
+            segment->objects[write++] = object;
+        }
+        segment->count = write;
+    }
+    return NULL;
+}
+
+void _gallector_sweep_parallel(Gallector *this, GcJob *job, bool isOld)
+{
+    GcList *list = isOld ? &this->old : &this->young;
+    int count = _gclist_segments(list);
+    if (count == 0) return;
+    GcSegment **segments = pct_allocator_libc.malloc(NULL, sizeof(GcSegment *) * count);
+    int index = 0;
+    for (GcSegment *segment = list->head; segment != NULL; segment = segment->next) segments[index++] = segment;
+    job->segments = segments;
+    job->segmentCount = count;
+    job->isOld = isOld;
+    for (int i = 0; i < job->threads; i++) {
+        job->workers[i].freed = 0;
+        job->workers[i].promoted = 0;
+    }
+    _gallector_run(job, _gallector_sweep_worker);
+    for (int i = 0; i < job->threads; i++) {
+        this->numObjects -= job->workers[i].freed;
+        if (!isOld) this->numYoung -= job->workers[i].freed;
+        this->sweepFreed += job->workers[i].freed;
+    }
+    // promoted objects leave their young segment, then empty segments go
+    GcSegment *previous = NULL;
+    for (int i = 0; i < count; i++) {
+        GcSegment *segment = segments[i];
+        if (!isOld) {
+            int write = 0;
+            for (int read = 0; read < segment->count; read++) {
+                GcObject *object = segment->objects[read];
+                if (GcObject_isOld(object)) {
+                    Object_setFlag(object, OBJECT_FLAG_OLD, false);
+                    _gallector_promote(this, object);
+                } else {
+                    segment->objects[write++] = object;
+                }
+            }
+            segment->count = write;
+        }
+        if (segment->count == 0) {
+            _gclist_drop(list, previous, segment);
+        } else {
+            previous = segment;
+        }
+    }
+    pct_allocator_libc.free(NULL, segments);
+}
+
+// objects do not remember their creator, so caches are only safe when every tracked object
+// comes from the one creator they share, otherwise everything goes to the freeer
+Gache **_gallector_sweep_caches(Gallector *this, int threads, Gache **caches)
+{
+    if (caches == NULL || this->depotCount != 1) return NULL;
+    GACHE_CREATE_FUNC creator = this->depots[0]->creator;
+    for (int i = 0; i < threads; i++) {
+        Gache *cache = caches[i];
+        if (cache == NULL) continue;
+        if (cache->gallector != (Object *)this || cache->creator != creator) return NULL;
+    }
+    return caches;
+}
+
+// stop the world collection on several threads, finishes the running cycle like Gallector_sweep,
+// caches holds one Gache per thread for the freed objects, whatever they refuse goes to the freeer,
+// which then has to be thread safe, the survivors and their order do not depend on the threads,
+// caches[i] must all belong to this gallector and share one creator, and the gallector must not
+// track objects of any other creator, else the caches are ignored
+int Gallector_sweepParallel(Gallector *this, int threads, Gache **caches)
+{
+    if (this->phase == GALLECTOR_MARK) Gallector_markParallel(this, threads);
+    if (this->phase == GALLECTOR_SWEEP && this->sweepStarted) {
+        int freed = this->sweepFreed;
+        Gallector_sweepFinish(this);
+        return this->sweepFreed - freed;
+    }
+    if (this->phase == GALLECTOR_IDLE) _gallector_sweep_begin(this);
+    GcWorker workers[GALLECTOR_MAX_THREADS];
+    GcJob job;
+    _gallector_job_init(&job, this, workers, threads);
+    job.caches = _gallector_sweep_caches(this, job.threads, caches);
+    if (this->kind == GALLECTOR_MAJOR) {
+        // the workers can not touch the remembered set, forget the old objects about to go first
+        for (int i = 0; i < this->rememberedCount; ) {
+            GcObject *object = this->remembered[i];
+            if (GcObject_isMarked(object) || GcObject_isFrozen(object)) {
+                i++;
+                continue;
+            }
+            Object_setFlag(object, OBJECT_FLAG_REMEMBERED, false);
+            this->remembered[i] = this->remembered[--this->rememberedCount];
+        }
+        _gallector_sweep_parallel(this, &job, true);
+    }
+    _gallector_sweep_parallel(this, &job, false);
+    _gallector_sweep_end(this);
+    return this->sweepFreed;
 }
 
 void Gallector_print(Gallector *this)
 {
-    printf("[(GALLECTOR) => p:%p, s:%d]\n", this, this->numObjects);
+    printf("[(GALLECTOR) => p:%p, s:%d, y:%d, r:%d]\n", this, this->numObjects, this->numYoung, this->rememberedCount);
 }
 
 void Gallector_free(Gallector *this)
 {
-    this->first = NULL;
+    _gclist_clear(&this->young);
+    _gclist_clear(&this->old);
+    if (this->grays != NULL) pct_free(this->grays);
+    if (this->remembered != NULL) pct_free(this->remembered);
+    // caches still alive hand their objects to the depots to be freed below,
+    // afterwards they only create and refuse returns
+    for (int i = 0; i < this->gacheCount; i++) {
+        Gache *gache = this->gaches[i];
+        _gache_flush(gache, gache->count, true);
+        gache->gallector = NULL;
+        gache->depot = NULL;
+    }
+    for (int i = 0; i < this->depotCount; i++) {
+        this->depots[i]->limit = 0;
+        _gcdepot_trim(this, this->depots[i]);
+        pct_free(this->depots[i]);
+    }
+    if (this->depots != NULL) pct_free(this->depots);
+    if (this->gaches != NULL) pct_free(this->gaches);
     Object_free(this);
 }
 
-// 
+//
 // Gallector *gallector = Gallector_new(1000, _freeFunc);
-// Gache *gache = Gallector_cache(gallector, 100, _createFunc);
-// void *obj = Gache_get(gache, true);
-// obj->gcFreeze = true; // no gc
-// obj->gcMark = 1;
+// Gache *gache = Gallector_cache(gallector, 100, _createFunc); // objects embed struct _GcObject
+// GcObject *obj = Gache_get(gache, true);
+// GcObject_setFreeze(obj, true); // no gc
+// GcObject_setMark(obj, true);
 // Gallector_sweep(gallector);
-// 
+// Gache_return(gache, obj); // recycle by hand, false when full
+// Gache_print(gache); // hit rate, idle objects drain at every cycle end
+//
+// incremental, spread over frames:
+// Gallector_setTracer(gallector, _traceFunc); // Gallector_shade(gallector, child) for each child
+// Gallector_markBegin(gallector);
+// Gallector_shade(gallector, root);
+// GALLECTOR_WRITE(gallector, parent, child, other); // stores made while marking
+// Gallector_step(gallector, 0, 2000000); // once per frame, 2ms
+//
+// generational, minor cycles often and major ones rarely:
+// Gallector_minorBegin(gallector); // or Gallector_markBegin for a major one
+// Gallector_shade(gallector, root);
+// Gallector_sweepMinor(gallector); // or keep calling Gallector_step
+//
+// parallel, with the mutator paused:
+// Gallector_markBegin(gallector);
+// Gallector_shade(gallector, root);
+// Gallector_sweepParallel(gallector, 4, caches); // Gache *caches[4], one per thread
+//
 
 #endif
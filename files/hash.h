@@ -0,0 +1,140 @@
+// hash
+
+// https://github.com/wangyi-fudan/wyhash
+
+#ifndef H_PCT_HASH
+#define H_PCT_HASH
+
+#include "header.h"  // [M[ IGNORE ]M]
+
+// #define PCT_HASH_RANDOM_SEED
+
+uint64_t _hash_secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+uint64_t _hash_seed = 0;
+bool _hash_seeded = false;
+
+void _hash_mum(uint64_t *a, uint64_t *b)
+{
+    #if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+    #else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    #endif
+}
+
+uint64_t _hash_mix(uint64_t a, uint64_t b)
+{
+    _hash_mum(&a, &b);
+    return a ^ b;
+}
+
+uint64_t _hash_read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+uint64_t _hash_read4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint64_t _hash_read3(const uint8_t *p, size_t k)
+{
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+// changing the seed invalidates every hash computed before, set it at startup
+void hash_set_seed(uint64_t seed)
+{
+    _hash_seed = seed;
+    _hash_seeded = true;
+}
+
+// seeds from the os entropy when present, against hash flooding
+uint64_t hash_random_seed()
+{
+    uint64_t seed = 0;
+    FILE *file = fopen("/dev/urandom", "rb");
+    if (file != NULL) {
+        if (fread(&seed, sizeof(seed), 1, file) != 1) seed = 0;
+        fclose(file);
+    }
+    if (seed == 0) {
+        seed = _hash_mix((uint64_t)time(NULL) ^ _hash_secret[0], (uint64_t)clock() ^ (uint64_t)(uintptr_t)&seed);
+    }
+    hash_set_seed(seed);
+    return seed;
+}
+
+uint64_t hash_get_seed()
+{
+    #ifdef PCT_HASH_RANDOM_SEED
+    if (!_hash_seeded) hash_random_seed();
+    #endif
+    return _hash_seed;
+}
+
+// wyhash final4, reads 8 bytes at a time and never stops on '\0'
+uint64_t hash_bytes(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t *secret = _hash_secret;
+    uint64_t seed = hash_get_seed();
+    seed ^= _hash_mix(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (_hash_read4(p) << 32) | _hash_read4(p + ((len >> 3) << 2));
+            b = (_hash_read4(p + len - 4) << 32) | _hash_read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = _hash_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = _hash_mix(_hash_read8(p) ^ secret[1], _hash_read8(p + 8) ^ seed);
+                see1 = _hash_mix(_hash_read8(p + 16) ^ secret[2], _hash_read8(p + 24) ^ see1);
+                see2 = _hash_mix(_hash_read8(p + 32) ^ secret[3], _hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = _hash_mix(_hash_read8(p) ^ secret[1], _hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = _hash_read8(p + i - 16);
+        b = _hash_read8(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    _hash_mum(&a, &b);
+    return _hash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+uint64_t hash_string(const char *str)
+{
+    return hash_bytes(str, strlen(str));
+}
+
+#endif
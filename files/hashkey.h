@@ -7,7 +7,7 @@ typedef struct _Hashkey {
     struct _Object;
     String *key;
     void *value;
-    struct _Hashkey *next;
+    uint64_t hash;
 } Hashkey;
 
 
@@ -17,24 +17,27 @@ Hashkey *Hashkey_set(Hashkey *this, void *value)
     return this;
 }
 
-Hashkey *Hashkey_new(String *key, void *value)
+Hashkey *Hashkey_newWithHash(String *key, uint64_t hash, void *value)
 {
-    Hashkey *hashkey = (Hashkey *)pct_mallloc(sizeof(Hashkey));
+    Hashkey *hashkey = (Hashkey *)Object_newPooled(sizeof(Hashkey), PCT_OBJ_HASHKEY);
     hashkey->key = key;
     hashkey->value = value;
-    hashkey->next = NULL;
+    hashkey->hash = hash;
     Object_retain(key);
-    Object_init(hashkey, PCT_OBJ_HASHKEY);
     return hashkey;
 }
 
+Hashkey *Hashkey_new(String *key, void *value)
+{
+    return Hashkey_newWithHash(key, String_hash(key), value);
+}
+
 void Hashkey_free(void *_this)
 {
     Hashkey *this = _this;
     Object_release(this->key);
     this->key = NULL;
     this->value = NULL;
-    this->next = NULL;
     Object_free(this);
 }
 
@@ -6,40 +6,207 @@
 #include "header.h"  // [M[ IGNORE ]M]
 #include "hashkey.h" // [M[ IGNORE ]M]
 
-#define HASHMAP_DEFAULT_CAPACITY 4096
+// open addressing with robin hood probing, slots grow by doubling
+// and old slots are migrated a few at a time on every write
+#define HASHMAP_DEFAULT_CAPACITY 16
+#define HASHMAP_LOAD_FACTOR 0.8
+#define HASHMAP_REHASH_STEP 16
 
+// hash keeps the low bits of Hashkey->hash, which also pick the home slot
+// distance is probe length + 1, so 0 marks an empty slot
+// a NULL key with a distance is a tombstone, only left in the draining table
+typedef struct _HashmapSlot {
+    unsigned int hash;
+    unsigned int distance;
+    Hashkey *key;
+} HashmapSlot;
+
+typedef struct _HashmapTable {
+    HashmapSlot *slots;
+    int capacity;
+    int count;
+} HashmapTable;
+
+// tables[0] is the main table, while rehashing it drains into tables[1]
 typedef struct _Hashmap {
     struct _Object;
     int size;
     bool retain;
-    Hashkey *bucket[HASHMAP_DEFAULT_CAPACITY];
+    int rehashing;
+    HashmapTable tables[2];
 } Hashmap;
 
+void _hashmap_table_reset(HashmapTable *table)
+{
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+void _hashmap_table_init(HashmapTable *table, int capacity)
+{
+    table->slots = (HashmapSlot *)pct_mallloc(sizeof(HashmapSlot) * capacity);
+    memset(table->slots, 0, sizeof(HashmapSlot) * capacity);
+    table->capacity = capacity;
+    table->count = 0;
+}
+
+void _hashmap_table_free(HashmapTable *table)
+{
+    if (table->slots != NULL) pct_free(table->slots);
+    _hashmap_table_reset(table);
+}
+
+bool _hashmap_key_equal(Hashkey *hashkey, uint64_t hash, const char *key, size_t len)
+{
+    if (hashkey->hash != hash) return false;
+    String *str = hashkey->key;
+    return (size_t)String_length(str) == len && memcmp(String_get(str), key, len) == 0;
+}
+
+HashmapSlot *_hashmap_table_find(HashmapTable *table, uint64_t hash, const char *key, size_t len)
+{
+    if (table->slots == NULL) return NULL;
+    int mask = table->capacity - 1;
+    int index = hash & mask;
+    unsigned int distance = 1;
+    while (true) {
+        HashmapSlot *slot = &table->slots[index];
+        // empty, or a richer slot that our key would have displaced
+        if (slot->distance < distance) return NULL;
+        if (slot->key != NULL && slot->hash == (unsigned int)hash && _hashmap_key_equal(slot->key, hash, key, len)) return slot;
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+void _hashmap_table_insert(HashmapTable *table, unsigned int hash, Hashkey *key)
+{
+    int mask = table->capacity - 1;
+    int index = hash & mask;
+    HashmapSlot entry = {hash, 1, key};
+    HashmapSlot temp;
+    while (true) {
+        HashmapSlot *slot = &table->slots[index];
+        if (slot->distance == 0) {
+            *slot = entry;
+            table->count++;
+            return;
+        }
+        if (slot->distance < entry.distance) {
+            temp = *slot;
+            *slot = entry;
+            entry = temp;
+        }
+        index = (index + 1) & mask;
+        entry.distance++;
+    }
+}
+
+void _hashmap_table_remove(HashmapTable *table, HashmapSlot *slot, bool isTombstone)
+{
+    table->count--;
+    if (isTombstone) {
+        slot->key = NULL;
+        return;
+    }
+    // backward shift, so no tombstone is left behind
+    int mask = table->capacity - 1;
+    int index = slot - table->slots;
+    int next = (index + 1) & mask;
+    while (table->slots[next].distance > 1) {
+        table->slots[index] = table->slots[next];
+        table->slots[index].distance--;
+        index = next;
+        next = (index + 1) & mask;
+    }
+    memset(&table->slots[index], 0, sizeof(HashmapSlot));
+}
+
+void _hashmap_rehash_step(Hashmap *this, int steps)
+{
+    if (this->rehashing < 0) return;
+    HashmapTable *from = &this->tables[0];
+    HashmapTable *to = &this->tables[1];
+    while (steps-- > 0 && from->count > 0 && this->rehashing < from->capacity) {
+        HashmapSlot *slot = &from->slots[this->rehashing++];
+        if (slot->key == NULL) continue;
+        _hashmap_table_insert(to, slot->hash, slot->key);
+        _hashmap_table_remove(from, slot, true);
+    }
+    if (from->count > 0 && this->rehashing < from->capacity) return;
+    _hashmap_table_free(from);
+    *from = *to;
+    _hashmap_table_reset(to);
+    this->rehashing = -1;
+}
+
+void _hashmap_check_resize(Hashmap *this)
+{
+    HashmapTable *table = &this->tables[0];
+    if (table->slots == NULL) {
+        _hashmap_table_init(table, HASHMAP_DEFAULT_CAPACITY);
+        return;
+    }
+    if (this->rehashing >= 0) {
+        _hashmap_rehash_step(this, HASHMAP_REHASH_STEP);
+        if (this->rehashing < 0) return _hashmap_check_resize(this);
+        HashmapTable *next = &this->tables[1];
+        if (next->count + 1 <= next->capacity * HASHMAP_LOAD_FACTOR) return;
+        // writes outpaced the migration, finish it at once
+        _hashmap_rehash_step(this, INT_MAX);
+    }
+    if (table->count + 1 <= table->capacity * HASHMAP_LOAD_FACTOR) return;
+    _hashmap_table_init(&this->tables[1], table->capacity * 2);
+    this->rehashing = 0;
+    _hashmap_rehash_step(this, HASHMAP_REHASH_STEP);
+}
+
+HashmapTable *_hashmap_active_table(Hashmap *this)
+{
+    return this->rehashing >= 0 ? &this->tables[1] : &this->tables[0];
+}
+
+HashmapSlot *_hashmap_find(Hashmap *this, uint64_t hash, const char *key, size_t len, HashmapTable **table)
+{
+    HashmapSlot *slot = NULL;
+    if (this->rehashing >= 0) {
+        *table = &this->tables[1];
+        slot = _hashmap_table_find(*table, hash, key, len);
+        if (slot != NULL) return slot;
+    }
+    *table = &this->tables[0];
+    return _hashmap_table_find(*table, hash, key, len);
+}
+
 Hashmap* Hashmap_new(bool isRetainValue) {
     Hashmap *map = (Hashmap *)pct_mallloc(sizeof(Hashmap));
     Object_init(map, PCT_OBJ_HASHMAP);
     map->retain = isRetainValue;
-    map->size = HASHMAP_DEFAULT_CAPACITY;
-    for (int i = 0; i < map->size; ++i ) map->bucket[i] = NULL;
+    map->size = 0;
+    map->rehashing = -1;
+    _hashmap_table_reset(&map->tables[0]);
+    _hashmap_table_reset(&map->tables[1]);
     return map;
 }
 
 
 void Hashmap_clear(Hashmap *this) {
     Hashkey *ptr;
-    Hashkey *tmp;
-    for (int i = 0; i < this->size; ++i) {
-        ptr = this->bucket[i];
-        while (ptr != NULL) {
-            tmp = ptr;
-            ptr = ptr->next;
+    for (int t = 0; t < 2; ++t) {
+        HashmapTable *table = &this->tables[t];
+        for (int i = 0; i < table->capacity; ++i) {
+            ptr = table->slots[i].key;
+            if (ptr == NULL) continue;
             if (this->retain) {
-                Object_release(tmp->value);
+                Object_release(ptr->value);
             }
-            Object_release(tmp);
+            Object_release(ptr);
         }
-        this->bucket[i] = NULL;
+        _hashmap_table_free(table);
     }
+    this->size = 0;
+    this->rehashing = -1;
 }
 
 // TODO: release removed value
@@ -51,144 +218,136 @@ void Hashmap_free(Hashmap *this) {
 
 typedef bool (*HASHMAP_SET_FUNC)(void *, void *);
 
-void *Hashmap_setByCheck(Hashmap *this, char *_key, void *value, HASHMAP_SET_FUNC func) {
+// the *H variants take a hash from Hashmap_hashKey, so hot keys can be hashed once
+uint64_t Hashmap_hashKey(const char *key, size_t len)
+{
+    return hash_bytes(key, len);
+}
+
+void *Hashmap_setByCheckH(Hashmap *this, const char *_key, size_t len, uint64_t hash, void *value, HASHMAP_SET_FUNC func) {
     assert(this != NULL);
     assert(_key != NULL);
     assert(value != NULL);
-    String *key = String_format(_key);
-    int pos = String_hash(key) % this->size;
-    // new position
-    Hashkey *ptr = this->bucket[pos];
-    if (ptr == NULL) {
-        if (func(NULL, value)) {
-            this->bucket[pos] = Hashkey_new(key, value);
-            if (this->retain) Object_retain(value);
-        }
-        Object_release(key);
-        return NULL;
-    }
+    HashmapTable *table = NULL;
+    HashmapSlot *slot = _hashmap_find(this, hash, _key, len, &table);
     // replace old
-    void *tmp = NULL;
     void *rpl = NULL;
-    while (ptr != NULL) {
-        if (String_equal(key, ptr->key)) {
-            tmp = ptr->value;
-            if (func(tmp, value)) {
-                rpl = tmp;
-                Hashkey_set(ptr, value);
-                if (this->retain) {
-                    Object_retain(value);
-                    Object_release(rpl);
-                }
+    if (slot != NULL) {
+        void *tmp = slot->key->value;
+        if (func(tmp, value)) {
+            rpl = tmp;
+            Hashkey_set(slot->key, value);
+            if (this->retain) {
+                Object_retain(value);
+                Object_release(rpl);
             }
-            break;
         }
-        ptr = ptr->next;
-    }
-    if (rpl != NULL) {
-        Object_release(key);
         return rpl;
     }
-    // prepend position
+    // new position, the key is only copied here
     if (func(NULL, value)) {
-        Hashkey *pnode = Hashkey_new(key, value);
-        pnode->next = this->bucket[pos];
-        this->bucket[pos] = pnode;
+        String *key = String_appendBytes(String_new(), _key, len);
+        _hashmap_check_resize(this);
+        _hashmap_table_insert(_hashmap_active_table(this), hash, Hashkey_newWithHash(key, hash, value));
+        Object_release(key);
+        this->size++;
         if (this->retain) Object_retain(value);
     }
-    Object_release(key);
     return NULL;
 }
 
+void *Hashmap_setByCheckN(Hashmap *this, const char *_key, size_t len, void *value, HASHMAP_SET_FUNC func) {
+    return Hashmap_setByCheckH(this, _key, len, Hashmap_hashKey(_key, len), value, func);
+}
+
+void *Hashmap_setByCheck(Hashmap *this, char *_key, void *value, HASHMAP_SET_FUNC func) {
+    assert(_key != NULL);
+    return Hashmap_setByCheckN(this, _key, strlen(_key), value, func);
+}
+
 bool _hashmap_set_by_default(void *_old, void *_new) {
     return true;
 }
 
+void *Hashmap_setH(Hashmap *this, const char *_key, size_t len, uint64_t hash, void *value) {
+    return Hashmap_setByCheckH(this, _key, len, hash, value, _hashmap_set_by_default);
+}
+
+void *Hashmap_setN(Hashmap *this, const char *_key, size_t len, void *value) {
+    return Hashmap_setByCheckN(this, _key, len, value, _hashmap_set_by_default);
+}
+
 void *Hashmap_set(Hashmap *this, char *_key, void *value) {
     return Hashmap_setByCheck(this, _key, value, _hashmap_set_by_default);
 }
 
-void *Hashmap_get(Hashmap *this, char *_key) {
+void *Hashmap_getH(Hashmap *this, const char *_key, size_t len, uint64_t hash) {
     assert(this != NULL);
     assert(_key != NULL);
-    String *key = String_format(_key);
-    int pos = String_hash(key) % this->size;
-    //
-    Hashkey *ptr = this->bucket[pos];
-    while (ptr != NULL) {
-        if (String_equal(key, ptr->key)) {
-            Object_release(key);
-            return ptr->value;
-        }
-        ptr = ptr->next;
-    }
-    Object_release(key);
-    return NULL;
+    HashmapTable *table = NULL;
+    HashmapSlot *slot = _hashmap_find(this, hash, _key, len, &table);
+    return slot != NULL ? slot->key->value : NULL;
+}
+
+void *Hashmap_getN(Hashmap *this, const char *_key, size_t len) {
+    return Hashmap_getH(this, _key, len, Hashmap_hashKey(_key, len));
+}
+
+void *Hashmap_get(Hashmap *this, char *_key) {
+    assert(_key != NULL);
+    return Hashmap_getN(this, _key, strlen(_key));
 }
 
 // TODO: release removed value
-void *Hashmap_del(Hashmap *this, char *_key) {
+void *Hashmap_delH(Hashmap *this, const char *_key, size_t len, uint64_t hash) {
     assert(this != NULL);
     assert(_key != NULL);
-    String *key = String_format(_key);
-    int pos = String_hash(key) % this->size;
+    HashmapTable *table = NULL;
+    HashmapSlot *slot = _hashmap_find(this, hash, _key, len, &table);
+    if (slot == NULL) return NULL;
     //
-    void *tmp = NULL;
-    Hashkey *ptr = this->bucket[pos];
-    if (ptr == NULL) {
-        Object_release(key);
-        return NULL;
+    Hashkey *ptr = slot->key;
+    void *tmp = ptr->value;
+    bool isDraining = this->rehashing >= 0 && table == &this->tables[0];
+    _hashmap_table_remove(table, slot, isDraining);
+    this->size--;
+    if (this->retain) {
+        Object_release(ptr->value);
     }
-    Hashkey *pre = NULL;
-    while (ptr != NULL) {
-        if (String_equal(key, ptr->key)) {
-            if (pre == NULL) {
-                this->bucket[pos] = NULL;
-            } else {
-                pre->next = ptr->next;
-            }
-            tmp = ptr->value;
-            if (this->retain) {
-                Object_release(ptr->value);
-            }
-            Object_release(ptr);
-            break;
-        }
-        pre = ptr;
-        ptr = ptr->next;
-    }
-    Object_release(key);
+    Object_release(ptr);
+    _hashmap_rehash_step(this, HASHMAP_REHASH_STEP);
     return tmp;
 }
 
+void *Hashmap_delN(Hashmap *this, const char *_key, size_t len) {
+    return Hashmap_delH(this, _key, len, Hashmap_hashKey(_key, len));
+}
+
+void *Hashmap_del(Hashmap *this, char *_key) {
+    assert(_key != NULL);
+    return Hashmap_delN(this, _key, strlen(_key));
+}
+
 #define HASHMAP_FOREACH_START(_map) \
-    int idx = 0; \
     Hashmap *$map = _map; \
     Hashkey *$ptr = NULL; \
-    $ptr = $map->bucket[idx]; \
-    while (true) { \
-        if ($ptr == NULL) { \
-            if (idx >= $map->size) { \
-                break; \
-            } \
-            idx++; \
-            $ptr = $map->bucket[idx]; \
-            continue; \
-        }
+    int $cap = $map->tables[0].capacity; \
+    for (int idx = 0; idx < $cap + $map->tables[1].capacity; idx++) { \
+        $ptr = idx < $cap ? $map->tables[0].slots[idx].key : $map->tables[1].slots[idx - $cap].key; \
+        if ($ptr == NULL) continue;
 
 #define HASHMAP_FOREACH_END \
-        $ptr = $ptr->next; \
     } \
 
 typedef void (*HASHMAP_FOREACH_FUNC)(Hashkey *, void *);
 
 void Hashmap_foreachItem(Hashmap *this, HASHMAP_FOREACH_FUNC func, void *arg) {
     Hashkey *ptr;
-    for (int i = 0; i < this->size; ++i) {
-        ptr = this->bucket[i];
-        while (ptr != NULL) {
-            func(ptr, arg);
-            ptr = ptr->next;
+    for (int t = 0; t < 2; ++t) {
+        HashmapTable *table = &this->tables[t];
+        for (int i = 0; i < table->capacity; ++i) {
+            ptr = table->slots[i].key;
+            if (ptr != NULL) func(ptr, arg);
         }
     }
 }
@@ -196,8 +355,7 @@ void Hashmap_foreachItem(Hashmap *this, HASHMAP_FOREACH_FUNC func, void *arg) {
 void _hashmap_copy_to_other(Hashkey *hashkey, void *other) {
     String *key = hashkey->key;
     void *val = hashkey->value;
-    char *_key = String_get(key);
-    Hashmap_set(other, _key, val);
+    Hashmap_setN(other, String_get(key), String_length(key), val);
 }
 
 void Hashmap_copyTo(Hashmap *this, Hashmap *other)
@@ -205,6 +363,36 @@ void Hashmap_copyTo(Hashmap *this, Hashmap *other)
     Hashmap_foreachItem(this, _hashmap_copy_to_other, other);
 }
 
+// substitutes every {key} with the String stored under key in one scan,
+// unknown keys are kept as they are
+String *String_replaceKeys(String *this, Hashmap *values)
+{
+    StrView view = String_view(this);
+    int scan = 0;
+    int copied = 0;
+    int open = -1;
+    String *result = NULL;
+    while ((open = StrView_findChar(view, scan, '{')) >= 0) {
+        int close = StrView_findChar(view, open + 1, '}');
+        if (close < 0) break;
+        String *value = Hashmap_getN(values, view.ptr + open + 1, close - open - 1);
+        if (value == NULL) {
+            scan = open + 1;
+            continue;
+        }
+        if (result == NULL) {
+            result = String_new();
+            _string_check_capacity(result, view.len);
+        }
+        String_appendBytes(result, view.ptr + copied, open - copied);
+        String_appendView(result, String_view(value));
+        copied = scan = close + 1;
+    }
+    if (result == NULL) return this;
+    String_appendBytes(result, view.ptr + copied, view.len - copied);
+    return _string_take(this, result);
+}
+
 char *Hashmap_toString(Hashmap *this)
 {
     return tools_format("[Hashmap => p:%p s:%i]", this, this->size);
@@ -13,6 +13,7 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include <math.h>
 #include <time.h>
@@ -26,36 +27,137 @@
 #include <unistd.h>
 #endif
 
-// object types
-#define PCT_OBJ_OBJECT 'O'
-#define PCT_OBJ_GALLECTOR 'G'
-#define PCT_OBJ_STRING 'S'
-#define PCT_OBJ_ARRAY 'A'
-#define PCT_OBJ_CURSOR 'U'
-#define PCT_OBJ_CHAIN 'C'
-#define PCT_OBJ_STACK 'S'
-#define PCT_OBJ_QUEUE 'Q'
-#define PCT_OBJ_HASHKEY 'h'
-#define PCT_OBJ_HASHMAP 'H'
-#define PCT_OBJ_FOLIAGE 'F'
-#define PCT_OBJ_BLOCK 'B'
-#define PCT_OBJ_TIMER 'T'
+// object types, small ids into pct_object_types, user types register from PCT_OBJ_USER
+#define PCT_OBJ_OBJECT 1
+#define PCT_OBJ_GALLECTOR 2
+#define PCT_OBJ_STRING 3
+#define PCT_OBJ_ARRAY 4
+#define PCT_OBJ_CURSOR 5
+#define PCT_OBJ_CHAIN 6
+#define PCT_OBJ_STACK 7
+#define PCT_OBJ_QUEUE 8
+#define PCT_OBJ_HASHKEY 9
+#define PCT_OBJ_HASHMAP 10
+#define PCT_OBJ_FOLIAGE 11
+#define PCT_OBJ_BLOCK 12
+#define PCT_OBJ_TIMER 13
+#define PCT_OBJ_GACHE 14
+#define PCT_OBJ_INTARRAY 15
+#define PCT_OBJ_INT64ARRAY 16
+#define PCT_OBJ_FLOATARRAY 17
+#define PCT_OBJ_DOUBLEARRAY 18
+#define PCT_OBJ_RINGQUEUE 19
+#define PCT_OBJ_ARRAYSTACK 20
+#define PCT_OBJ_SPSCQUEUE 21
+#define PCT_OBJ_MPMCQUEUE 22
+#define PCT_OBJ_UNROLLEDCHAIN 23
+#define PCT_OBJ_USER 32
+#define PCT_OBJ_TYPES 256
+
+#if defined(_MSC_VER)
+    #define PCT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+    #define PCT_THREAD_LOCAL __thread
+#else
+    #define PCT_THREAD_LOCAL _Thread_local
+#endif
 
-void *pct_mallloc(size_t size)
+// allocator table behind pct_mallloc/pct_realloc/pct_free, memory must be
+// released through the same allocator that handed it out
+typedef struct _PctAllocator {
+    void *(*malloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *object, size_t size);
+    void (*free)(void *context, void *object);
+    void *context;
+} PctAllocator;
+
+void *_pct_libc_malloc(void *context, size_t size)
 {
     return malloc(size);
 }
 
-void *pct_realloc(void *object, size_t size)
+void *_pct_libc_realloc(void *context, void *object, size_t size)
 {
     return realloc(object, size);
 }
 
-void pct_free(void *object)
+void _pct_libc_free(void *context, void *object)
 {
     free(object);
 }
 
+PctAllocator pct_allocator_libc = {_pct_libc_malloc, _pct_libc_realloc, _pct_libc_free, NULL};
+PctAllocator *_pct_allocator_global = &pct_allocator_libc;
+PCT_THREAD_LOCAL PctAllocator *_pct_allocator_local = NULL;
+
+// the calling thread's allocator wins over the global one
+PctAllocator *pct_allocator_get()
+{
+    return _pct_allocator_local != NULL ? _pct_allocator_local : _pct_allocator_global;
+}
+
+// NULL restores the libc allocator, returns the previous one
+PctAllocator *pct_allocator_set(PctAllocator *allocator)
+{
+    PctAllocator *previous = _pct_allocator_global;
+    _pct_allocator_global = allocator != NULL ? allocator : &pct_allocator_libc;
+    return previous;
+}
+
+// NULL falls back to the global allocator, returns the previous one
+PctAllocator *pct_allocator_set_local(PctAllocator *allocator)
+{
+    PctAllocator *previous = _pct_allocator_local;
+    _pct_allocator_local = allocator;
+    return previous;
+}
+
+// #define PCT_ALLOC_TRACK
+
+// allocation tracking lives in track.h, compiled out the calls below go straight to the allocator
+#ifdef PCT_ALLOC_TRACK
+    #if defined(__GNUC__)
+        #define PCT_CALL_SITE() __builtin_return_address(0)
+    #else
+        #define PCT_CALL_SITE() NULL
+    #endif
+void *_pct_track_malloc(PctAllocator *allocator, size_t size, void *site);
+void *_pct_track_realloc(PctAllocator *allocator, void *object, size_t size);
+void _pct_track_free(PctAllocator *allocator, void *object);
+void _pct_track_object(int type, size_t size, int delta);
+size_t pct_track_size(void *object);
+#endif
+
+void *pct_mallloc(size_t size)
+{
+    PctAllocator *allocator = pct_allocator_get();
+    #ifdef PCT_ALLOC_TRACK
+    return _pct_track_malloc(allocator, size, PCT_CALL_SITE());
+    #else
+    return allocator->malloc(allocator->context, size);
+    #endif
+}
+
+void *pct_realloc(void *object, size_t size)
+{
+    PctAllocator *allocator = pct_allocator_get();
+    #ifdef PCT_ALLOC_TRACK
+    return _pct_track_realloc(allocator, object, size);
+    #else
+    return allocator->realloc(allocator->context, object, size);
+    #endif
+}
+
+void pct_free(void *object)
+{
+    PctAllocator *allocator = pct_allocator_get();
+    #ifdef PCT_ALLOC_TRACK
+    _pct_track_free(allocator, object);
+    #else
+    allocator->free(allocator->context, object);
+    #endif
+}
+
 #if defined(_WIN32) || defined(_WIN64)
     #define popen _popen
     #define pclose _pclose
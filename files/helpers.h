@@ -10,36 +10,51 @@ void pct_print_some_object()
     printf("test...\n");
 }
 
+// builtin entries of the object type table, Object_registerType adds more
+ObjectType pct_object_types[PCT_OBJ_TYPES] = {
+    [PCT_OBJ_OBJECT] = {"Object", sizeof(Object), NULL, NULL, NULL, NULL},
+    [PCT_OBJ_GALLECTOR] = {"Gallector", sizeof(Gallector), (OBJECT_FREE_FUNC)Gallector_free, (OBJECT_PRINT_FUNC)Gallector_print, NULL, NULL},
+    [PCT_OBJ_STRING] = {"String", sizeof(String), (OBJECT_FREE_FUNC)String_free, (OBJECT_PRINT_FUNC)String_print, (OBJECT_HASH_FUNC)String_hash, (OBJECT_EQUAL_FUNC)String_equal},
+    [PCT_OBJ_ARRAY] = {"Array", sizeof(Array), (OBJECT_FREE_FUNC)Array_free, NULL, NULL, NULL},
+    [PCT_OBJ_CURSOR] = {"Cursor", sizeof(Cursor), (OBJECT_FREE_FUNC)Cursor_free, (OBJECT_PRINT_FUNC)Cursor_print, NULL, NULL},
+    [PCT_OBJ_CHAIN] = {"Chain", sizeof(Chain), (OBJECT_FREE_FUNC)Chain_free, (OBJECT_PRINT_FUNC)Chain_print, NULL, NULL},
+    [PCT_OBJ_UNROLLEDCHAIN] = {"UnrolledChain", sizeof(UnrolledChain), (OBJECT_FREE_FUNC)UnrolledChain_free, (OBJECT_PRINT_FUNC)UnrolledChain_print, NULL, NULL},
+    [PCT_OBJ_STACK] = {"Stack", sizeof(Stack), (OBJECT_FREE_FUNC)Stack_free, (OBJECT_PRINT_FUNC)Stack_print, NULL, NULL},
+    [PCT_OBJ_QUEUE] = {"Queue", sizeof(Queue), (OBJECT_FREE_FUNC)Queue_free, (OBJECT_PRINT_FUNC)Queue_print, NULL, NULL},
+    [PCT_OBJ_RINGQUEUE] = {"RingQueue", sizeof(RingQueue), (OBJECT_FREE_FUNC)RingQueue_free, (OBJECT_PRINT_FUNC)RingQueue_print, NULL, NULL},
+    [PCT_OBJ_ARRAYSTACK] = {"ArrayStack", sizeof(ArrayStack), (OBJECT_FREE_FUNC)ArrayStack_free, (OBJECT_PRINT_FUNC)ArrayStack_print, NULL, NULL},
+    [PCT_OBJ_SPSCQUEUE] = {"SpscQueue", sizeof(SpscQueue), (OBJECT_FREE_FUNC)SpscQueue_free, (OBJECT_PRINT_FUNC)SpscQueue_print, NULL, NULL},
+    [PCT_OBJ_MPMCQUEUE] = {"MpmcQueue", sizeof(MpmcQueue), (OBJECT_FREE_FUNC)MpmcQueue_free, (OBJECT_PRINT_FUNC)MpmcQueue_print, NULL, NULL},
+    [PCT_OBJ_HASHKEY] = {"Hashkey", sizeof(Hashkey), Hashkey_free, NULL, NULL, NULL},
+    [PCT_OBJ_HASHMAP] = {"Hashmap", sizeof(Hashmap), (OBJECT_FREE_FUNC)Hashmap_free, NULL, NULL, NULL},
+    [PCT_OBJ_FOLIAGE] = {"Foliage", sizeof(Foliage), (OBJECT_FREE_FUNC)Foliage_free, Foliage_print, NULL, NULL},
+    [PCT_OBJ_BLOCK] = {"Block", sizeof(Block), Block_free, Block_print, NULL, NULL},
+    [PCT_OBJ_TIMER] = {"Timer", sizeof(Timer), NULL, NULL, NULL, NULL},
+    [PCT_OBJ_GACHE] = {"Gache", sizeof(Gache), (OBJECT_FREE_FUNC)Gache_free, (OBJECT_PRINT_FUNC)Gache_print, NULL, NULL},
+    [PCT_OBJ_INTARRAY] = {"IntArray", sizeof(IntArray), TypedArray_free, (OBJECT_PRINT_FUNC)IntArray_print, NULL, NULL},
+    [PCT_OBJ_INT64ARRAY] = {"Int64Array", sizeof(Int64Array), TypedArray_free, (OBJECT_PRINT_FUNC)Int64Array_print, NULL, NULL},
+    [PCT_OBJ_FLOATARRAY] = {"FloatArray", sizeof(FloatArray), TypedArray_free, (OBJECT_PRINT_FUNC)FloatArray_print, NULL, NULL},
+    [PCT_OBJ_DOUBLEARRAY] = {"DoubleArray", sizeof(DoubleArray), TypedArray_free, (OBJECT_PRINT_FUNC)DoubleArray_print, NULL, NULL},
+};
+
 // Object_initByType
 // Object_printByType
 // Object_freeByType
 void pct_object_free(void *_this)
 {
     if (_this == NULL) tools_error("null pointer to object free");
-    Object *this = _this;
-    int type = this->objType;
-    if (type == PCT_OBJ_OBJECT) return Object_free(this);
-    if (type == PCT_OBJ_GALLECTOR) return Gallector_free((Gallector *)this);
-    if (type == PCT_OBJ_STRING) return String_free((String *)this);
-    if (type == PCT_OBJ_ARRAY) return Array_free((Array *)this);
-    if (type == PCT_OBJ_CURSOR) return Cursor_free((Cursor *)this);
-    if (type == PCT_OBJ_CHAIN) return Chain_free((Chain *)this);
-    if (type == PCT_OBJ_STACK) return Stack_free((Stack *)this);
-    if (type == PCT_OBJ_QUEUE) return Queue_free((Queue *)this);
-    if (type == PCT_OBJ_HASHKEY) return Hashkey_free((Hashkey *)this);
-    if (type == PCT_OBJ_HASHMAP) return Hashmap_free((Hashmap *)this);
-    if (type == PCT_OBJ_FOLIAGE) return Foliage_free((Foliage *)this);
-    if (type == PCT_OBJ_BLOCK) return Block_free((Block *)this);
-    Object_free(this);
+    ObjectType *type = Object_getType(((Object *)_this)->objType);
+    if (type->free != NULL) return type->free(_this);
+    Object_free(_this);
 }
 
 void pct_object_print(void *_this)
 {
     if (_this == NULL) tools_error("null pointer to object print");
     Object *this = _this;
-    int type = this->objType;
-    int count = this->gcCount;
-    printf("<Object t:%c c:%i p:%p>\n", type, count, this);
+    ObjectType *type = Object_getType(this->objType);
+    if (type->print != NULL) return type->print(this);
+    printf("<Object t:%s c:%i p:%p>\n", Object_typeName(this), this->gcCount, this);
 }
 
 void helpers_free(void *pointer) {
@@ -49,20 +64,20 @@ void helpers_free(void *pointer) {
 char *system_execute(char *msg, ...) {
     va_list lst;
     va_start(lst, msg);
-    char *cmd = _tools_format(msg, lst);
+    String *cmd = String_appendFormatV(String_new(), msg, lst);
+    va_end(lst);
 
-    FILE *file;
-    if ((file = popen(cmd, "r")) == NULL) {
-        pct_free(cmd);
+    FILE *file = popen(String_get(cmd), "r");
+    Object_release(cmd);
+    if (file == NULL) {
         return NULL;
     }
     int BUFSIZE = 1024;
     char buf[BUFSIZE];
-    String *out = String_new();
-    char *temp1;
-    char *temp2;
-    while (fgets(buf, BUFSIZE, file) != NULL) {
-        String_appendArr(out, buf);
+    String *out = String_reserve(String_new(), BUFSIZE);
+    size_t size = 0;
+    while ((size = fread(buf, 1, BUFSIZE, file)) > 0) {
+        String_appendBytes(out, buf, size);
     }
     pclose(file);
     char *text = String_dump(out);
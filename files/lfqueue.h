@@ -0,0 +1,286 @@
+// lock-free queue
+
+#ifndef H_PCT_LFQUEUE
+#define H_PCT_LFQUEUE
+
+#include "header.h"  // [M[ IGNORE ]M]
+#include "object.h"  // [M[ IGNORE ]M]
+#include <stdatomic.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+// bounded queues for handing pointers between threads, SpscQueue for one producer and
+// one consumer, MpmcQueue (vyukov's bounded queue) for any number of both,
+// values are not retained and NULL can not be pushed since pop uses it for empty,
+// the hot indices sit LFQUEUE_CACHE_LINE bytes apart so producers and consumers do not false share
+
+#define LFQUEUE_CACHE_LINE 64
+#define LFQUEUE_SPINS 64
+
+// spins a while, then gives the cpu away
+void _lfqueue_wait(int *spins)
+{
+    if (++(*spins) < LFQUEUE_SPINS) return;
+    #ifdef _WIN32
+    SwitchToThread();
+    #else
+    sched_yield();
+    #endif
+}
+
+size_t _lfqueue_capacity(int capacity)
+{
+    size_t size = 2;
+    while (size < (size_t)capacity) size *= 2;
+    return size;
+}
+
+typedef struct _SpscQueue {
+    struct _Object;
+    void **items;
+    size_t mask;
+    char _pad0[LFQUEUE_CACHE_LINE];
+    // consumer side, cachedTail saves reading the producer's line on every pop
+    atomic_size_t head;
+    size_t cachedTail;
+    char _pad1[LFQUEUE_CACHE_LINE];
+    // producer side
+    atomic_size_t tail;
+    size_t cachedHead;
+    char _pad2[LFQUEUE_CACHE_LINE];
+} SpscQueue;
+
+// capacity is rounded up to a power of two
+SpscQueue *SpscQueue_new(int capacity)
+{
+    SpscQueue *queue = (SpscQueue *)pct_mallloc(sizeof(SpscQueue));
+    Object_init(queue, PCT_OBJ_SPSCQUEUE);
+    size_t size = _lfqueue_capacity(capacity);
+    queue->items = pct_mallloc(sizeof(void *) * size);
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->cachedTail = 0;
+    queue->cachedHead = 0;
+    return queue;
+}
+
+void SpscQueue_free(SpscQueue *this)
+{
+    pct_free(this->items);
+    this->items = NULL;
+    Object_free(this);
+}
+
+// a snapshot, exact only while neither side runs
+int SpscQueue_size(SpscQueue *this)
+{
+    size_t tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&this->head, memory_order_acquire);
+    return (int)(tail - head);
+}
+
+void SpscQueue_print(SpscQueue *this)
+{
+    printf("[(SPSCQUEUE) => p:%p, s:%d, c:%zu]\n", this, SpscQueue_size(this), this->mask + 1);
+}
+
+// producer only, false when full
+bool SpscQueue_tryPush(SpscQueue *this, void *data)
+{
+    if (data == NULL) return false;
+    size_t tail = atomic_load_explicit(&this->tail, memory_order_relaxed);
+    if (tail - this->cachedHead > this->mask) {
+        this->cachedHead = atomic_load_explicit(&this->head, memory_order_acquire);
+        if (tail - this->cachedHead > this->mask) return false;
+    }
+    this->items[tail & this->mask] = data;
+    atomic_store_explicit(&this->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// producer only, waits for room
+void SpscQueue_push(SpscQueue *this, void *data)
+{
+    if (data == NULL) return;
+    int spins = 0;
+    while (!SpscQueue_tryPush(this, data)) _lfqueue_wait(&spins);
+}
+
+// consumer only, up to max items in fifo order with one index update, returns how many
+int SpscQueue_popN(SpscQueue *this, void **out, int max)
+{
+    size_t head = atomic_load_explicit(&this->head, memory_order_relaxed);
+    if (this->cachedTail - head < (size_t)max) {
+        this->cachedTail = atomic_load_explicit(&this->tail, memory_order_acquire);
+    }
+    int count = (int)MIN(this->cachedTail - head, (size_t)MAX(max, 0));
+    for (int i = 0; i < count; i++) out[i] = this->items[(head + i) & this->mask];
+    if (count > 0) atomic_store_explicit(&this->head, head + count, memory_order_release);
+    return count;
+}
+
+// consumer only, NULL when empty
+void *SpscQueue_tryPop(SpscQueue *this)
+{
+    void *data = NULL;
+    SpscQueue_popN(this, &data, 1);
+    return data;
+}
+
+// consumer only, waits for an item
+void *SpscQueue_pop(SpscQueue *this)
+{
+    int spins = 0;
+    void *data;
+    while ((data = SpscQueue_tryPop(this)) == NULL) _lfqueue_wait(&spins);
+    return data;
+}
+
+// every cell carries a sequence number telling whose turn it is:
+// pos when a producer may fill it, pos + 1 when a consumer may empty it
+typedef struct _MpmcCell {
+    atomic_size_t sequence;
+    void *data;
+} MpmcCell;
+
+typedef struct _MpmcQueue {
+    struct _Object;
+    MpmcCell *cells;
+    size_t mask;
+    char _pad0[LFQUEUE_CACHE_LINE];
+    atomic_size_t enqueue;
+    char _pad1[LFQUEUE_CACHE_LINE];
+    atomic_size_t dequeue;
+    char _pad2[LFQUEUE_CACHE_LINE];
+} MpmcQueue;
+
+// capacity is rounded up to a power of two
+MpmcQueue *MpmcQueue_new(int capacity)
+{
+    MpmcQueue *queue = (MpmcQueue *)pct_mallloc(sizeof(MpmcQueue));
+    Object_init(queue, PCT_OBJ_MPMCQUEUE);
+    size_t size = _lfqueue_capacity(capacity);
+    queue->cells = pct_mallloc(sizeof(MpmcCell) * size);
+    queue->mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].data = NULL;
+    }
+    atomic_init(&queue->enqueue, 0);
+    atomic_init(&queue->dequeue, 0);
+    return queue;
+}
+
+void MpmcQueue_free(MpmcQueue *this)
+{
+    pct_free(this->cells);
+    this->cells = NULL;
+    Object_free(this);
+}
+
+// a snapshot, exact only while nobody pushes or pops
+int MpmcQueue_size(MpmcQueue *this)
+{
+    size_t enqueue = atomic_load_explicit(&this->enqueue, memory_order_acquire);
+    size_t dequeue = atomic_load_explicit(&this->dequeue, memory_order_acquire);
+    return enqueue > dequeue ? (int)(enqueue - dequeue) : 0;
+}
+
+void MpmcQueue_print(MpmcQueue *this)
+{
+    printf("[(MPMCQUEUE) => p:%p, s:%d, c:%zu]\n", this, MpmcQueue_size(this), this->mask + 1);
+}
+
+// false when full
+bool MpmcQueue_tryPush(MpmcQueue *this, void *data)
+{
+    if (data == NULL) return false;
+    size_t pos = atomic_load_explicit(&this->enqueue, memory_order_relaxed);
+    MpmcCell *cell;
+    while (true) {
+        cell = &this->cells[pos & this->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&this->enqueue, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&this->enqueue, memory_order_relaxed);
+        }
+    }
+    cell->data = data;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+void MpmcQueue_push(MpmcQueue *this, void *data)
+{
+    if (data == NULL) return;
+    int spins = 0;
+    while (!MpmcQueue_tryPush(this, data)) _lfqueue_wait(&spins);
+}
+
+// claims the run of filled cells at the front with a single cas, returns how many
+int MpmcQueue_popN(MpmcQueue *this, void **out, int max)
+{
+    if (max <= 0) return 0;
+    size_t pos = atomic_load_explicit(&this->dequeue, memory_order_relaxed);
+    while (true) {
+        int count = 0;
+        while (count < max && count <= (int)this->mask) {
+            MpmcCell *cell = &this->cells[(pos + count) & this->mask];
+            size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + count + 1);
+            if (diff != 0) {
+                // another consumer got ahead of us, start over from the current front
+                if (diff > 0 && count == 0) count = -1;
+                break;
+            }
+            count++;
+        }
+        if (count == 0) return 0;
+        if (count < 0) {
+            pos = atomic_load_explicit(&this->dequeue, memory_order_relaxed);
+            continue;
+        }
+        if (!atomic_compare_exchange_weak_explicit(&this->dequeue, &pos, pos + count, memory_order_relaxed, memory_order_relaxed)) continue;
+        for (int i = 0; i < count; i++) {
+            MpmcCell *cell = &this->cells[(pos + i) & this->mask];
+            out[i] = cell->data;
+            atomic_store_explicit(&cell->sequence, pos + i + this->mask + 1, memory_order_release);
+        }
+        return count;
+    }
+}
+
+// NULL when empty
+void *MpmcQueue_tryPop(MpmcQueue *this)
+{
+    void *data = NULL;
+    MpmcQueue_popN(this, &data, 1);
+    return data;
+}
+
+void *MpmcQueue_pop(MpmcQueue *this)
+{
+    int spins = 0;
+    void *data;
+    while ((data = MpmcQueue_tryPop(this)) == NULL) _lfqueue_wait(&spins);
+    return data;
+}
+
+//
+// MpmcQueue *jobs = MpmcQueue_new(1024);
+// MpmcQueue_push(jobs, job); // any producer thread, waits while full
+// void *batch[32];
+// int count = MpmcQueue_popN(jobs, batch, 32); // any consumer thread, never waits
+// Job *job = MpmcQueue_pop(jobs); // waits while empty
+// Object_release(jobs); // once every thread is done with it
+//
+
+#endif
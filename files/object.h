@@ -2,30 +2,107 @@
 #ifndef H_PCT_UG_OBJECT
 #define H_PCT_UG_OBJECT
 
+#include <stdatomic.h>
+
+// #define PCT_OBJECT_ATOMIC
+// #define PCT_OBJECT_DEBUG
+
 void pct_object_free(void *object);
 void pct_object_print(void *object);
 
+// type, pool class, flags and count share one 8 byte word,
+// objects a Gallector manages embed GcObject to get the cache link
 typedef struct _Object {
-    char objType;
+    unsigned char objType;
+    unsigned char objPool;
+    unsigned short objFlags;
     int gcCount;
-    char gcMark;
-    char gcFreeze;
-    void* gcNext;
 } Object;
 
-void Object_init(void *_this, char _objType)
+#define OBJECT_FLAG_MARK 0x1
+#define OBJECT_FLAG_FREEZE 0x2
+#define OBJECT_FLAG_ATOMIC 0x4
+#define OBJECT_FLAG_GRAY 0x8
+#define OBJECT_FLAG_OLD 0x10
+#define OBJECT_FLAG_REMEMBERED 0x20
+// counted in the per type tracking totals, Object_free only takes back what was counted
+#define OBJECT_FLAG_TRACKED 0x40
+// bits 8-11 count the sweeps a young GcObject survived
+#define OBJECT_AGE_SHIFT 8
+#define OBJECT_AGE_MASK 0xf00
+
+typedef void (*OBJECT_FREE_FUNC)(void *);
+typedef void (*OBJECT_PRINT_FUNC)(void *);
+typedef uint64_t (*OBJECT_HASH_FUNC)(void *);
+typedef bool (*OBJECT_EQUAL_FUNC)(void *, void *);
+
+// one entry per type id, NULL functions fall back to the plain Object behaviour
+typedef struct _ObjectType {
+    const char *name;
+    size_t size;
+    OBJECT_FREE_FUNC free;
+    OBJECT_PRINT_FUNC print;
+    OBJECT_HASH_FUNC hash;
+    OBJECT_EQUAL_FUNC equal;
+} ObjectType;
+
+// filled for the builtin types in helpers.h
+extern ObjectType pct_object_types[PCT_OBJ_TYPES];
+
+ObjectType *Object_getType(int type)
+{
+    return type >= 0 && type < PCT_OBJ_TYPES ? &pct_object_types[type] : NULL;
+}
+
+// takes the first free id from PCT_OBJ_USER on, -1 when the table is full
+int Object_registerType(ObjectType type)
+{
+    for (int i = PCT_OBJ_USER; i < PCT_OBJ_TYPES; i++) {
+        if (pct_object_types[i].name != NULL) continue;
+        pct_object_types[i] = type;
+        return i;
+    }
+    return -1;
+}
+
+const char *Object_typeName(void *_this)
+{
+    const char *name = pct_object_types[((Object *)_this)->objType].name;
+    return name != NULL ? name : "?";
+}
+
+#ifdef PCT_ALLOC_TRACK
+// pooled objects take their class size, the rest their type size,
+// the memory itself may come from anywhere, so nothing is read around the object
+size_t _object_size(Object *this)
+{
+    return this->objPool > 0 ? (size_t)this->objPool * POOL_CLASS_SIZE : pct_object_types[this->objType].size;
+}
+#endif
+
+// untracked objects stay out of the per type totals, for ones released behind Object_free's back
+void _object_setup(Object *this, int _objType, int _objPool, bool isTracked)
 {
-    Object *this = _this;
     this->objType = _objType;
+    this->objPool = _objPool;
+    this->objFlags = OBJECT_FLAG_FREEZE;
     this->gcCount = 1;
-    this->gcMark = 0;
-    this->gcFreeze = true;
-    this->gcNext = NULL;
+    #ifdef PCT_ALLOC_TRACK
+    if (isTracked) {
+        this->objFlags |= OBJECT_FLAG_TRACKED;
+        _pct_track_object(_objType, _object_size(this), 1);
+    }
+    #endif
     #ifdef H_PCT_OBJECT_CALLBACKS
     Object_initByType(this->objType, this);
     #endif
 }
 
+void Object_init(void *_this, int _objType)
+{
+    _object_setup(_this, _objType, 0, true);
+}
+
 Object *Object_new()
 {
     Object *object = (Object *)pct_mallloc(sizeof(Object));
@@ -34,16 +111,71 @@ Object *Object_new()
 }
 
 
+// small fixed size objects come from the pool unless another allocator is installed,
+// objPool keeps the size class + 1 so Object_free can hand them back
+void *Object_newPooled(size_t size, int type)
+{
+    int index = pct_allocator_get() == &pct_allocator_libc ? pool_class(size) : -1;
+    Object *object = index >= 0 ? pool_take(index) : NULL;
+    if (object == NULL) {
+        index = -1;
+        object = pct_mallloc(size);
+    }
+    _object_setup(object, type, index + 1, true);
+    return object;
+}
+
 void Object_free(void *_this)
 {
     Object *this = _this;
+    #ifdef PCT_ALLOC_TRACK
+    if (this->objFlags & OBJECT_FLAG_TRACKED) _pct_track_object(this->objType, _object_size(this), -1);
+    #endif
+    if (this->objPool > 0) return pool_give(this, this->objPool - 1);
     pct_free(this);
 }
 
+bool Object_hasFlag(void *_this, int flag)
+{
+    return (((Object *)_this)->objFlags & flag) != 0;
+}
+
+void Object_setFlag(void *_this, int flag, bool isSet)
+{
+    Object *this = _this;
+    this->objFlags = isSet ? (this->objFlags | flag) : (this->objFlags & ~flag);
+}
+
+// shared objects count with atomics, set it before handing the object to another thread,
+// PCT_OBJECT_ATOMIC makes every object shared
+void Object_setAtomic(void *_this, bool isAtomic)
+{
+    if (_this == NULL) tools_error("null pointer to object atomic");
+    Object *this = _this;
+    Object_setFlag(this, OBJECT_FLAG_ATOMIC, isAtomic);
+}
+
+bool Object_isAtomic(void *_this)
+{
+    #ifdef PCT_OBJECT_ATOMIC
+    return true;
+    #else
+    return Object_hasFlag(_this, OBJECT_FLAG_ATOMIC);
+    #endif
+}
+
+// gcCount stays a plain int so the header layout does not change with the mode
+#define _OBJECT_ATOMIC_COUNT(this) ((_Atomic int *)&(this)->gcCount)
+
 void Object_retain(void *_this)
 {
     if (_this == NULL) tools_error("null pointer to object retain");
     Object *this = _this;
+    if (Object_isAtomic(this)) {
+        // a new reference only comes from an existing one, nothing to order
+        atomic_fetch_add_explicit(_OBJECT_ATOMIC_COUNT(this), 1, memory_order_relaxed);
+        return;
+    }
     this->gcCount++;
 }
 
@@ -51,8 +183,14 @@ void Object_release(void *_this)
 {
     if (_this == NULL) tools_error("null pointer to object release");
     Object *this = _this;
-    this->gcCount--;
-    if (this->gcCount <= 0) {
+    int count;
+    if (Object_isAtomic(this)) {
+        // release publishes our writes, acquire on the last one sees everybody's before freeing
+        count = atomic_fetch_sub_explicit(_OBJECT_ATOMIC_COUNT(this), 1, memory_order_acq_rel) - 1;
+    } else {
+        count = --this->gcCount;
+    }
+    if (count <= 0) {
         #ifdef H_PCT_OBJECT_CALLBACKS
         Object_freeByType(this->objType, this);
         #else
@@ -72,4 +210,89 @@ void Object_print(void *_this)
     #endif
 }
 
+// identity unless the type brings its own hash
+uint64_t Object_hash(void *_this)
+{
+    if (_this == NULL) tools_error("null pointer to object hash");
+    ObjectType *type = Object_getType(((Object *)_this)->objType);
+    if (type->hash != NULL) return type->hash(_this);
+    return hash_bytes(&_this, sizeof(_this));
+}
+
+bool Object_equal(void *_this, void *_that)
+{
+    if (_this == _that) return true;
+    if (_this == NULL || _that == NULL) return false;
+    Object *this = _this;
+    Object *that = _that;
+    if (this->objType != that->objType) return false;
+    ObjectType *type = Object_getType(this->objType);
+    return type->equal != NULL && type->equal(this, that);
+}
+
+// 
+
+#ifdef PCT_OBJECT_DEBUG
+
+#ifndef _WIN32
+#include <pthread.h>
+
+#define _OBJECT_BENCH_THREADS 4
+
+void *_object_bench_worker(void *data)
+{
+    Object *object = data;
+    for (int i = 0; i < 1000000; i++) {
+        Object_retain(object);
+        Object_release(object);
+    }
+    return NULL;
+}
+#endif
+
+// wall clock seconds, clock() would sum the cpu time of every bench thread
+double _object_bench_now()
+{
+    #ifdef CLOCK_MONOTONIC
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+    #else
+    return (double)clock() / CLOCKS_PER_SEC;
+    #endif
+}
+
+double _object_bench_loop(Object *object, int loops)
+{
+    double begin = _object_bench_now();
+    for (int i = 0; i < loops; i++) {
+        Object_retain(object);
+        Object_release(object);
+    }
+    return _object_bench_now() - begin;
+}
+
+// plain vs atomic retain/release on one thread, then the atomic path under contention
+void _object_bench_main()
+{
+    int loops = 10000000;
+    Object *object = Object_new();
+    Object_setAtomic(object, false);
+    double plain = _object_bench_loop(object, loops);
+    Object_setAtomic(object, true);
+    double atomic = _object_bench_loop(object, loops);
+    printf("[(OBJECT) => plain:%.3fs, atomic:%.3fs, loops:%d]\n", plain, atomic, loops);
+    #ifndef _WIN32
+    pthread_t threads[_OBJECT_BENCH_THREADS];
+    double begin = _object_bench_now();
+    for (int i = 0; i < _OBJECT_BENCH_THREADS; i++) pthread_create(&threads[i], NULL, _object_bench_worker, object);
+    for (int i = 0; i < _OBJECT_BENCH_THREADS; i++) pthread_join(threads[i], NULL);
+    double shared = _object_bench_now() - begin;
+    printf("[(OBJECT) => shared:%.3fs, threads:%d, count:%d]\n", shared, _OBJECT_BENCH_THREADS, object->gcCount);
+    #endif
+    Object_release(object);
+}
+
+#endif
+
 #endif
@@ -0,0 +1,226 @@
+// pool
+
+#ifndef H_PCT_POOL
+#define H_PCT_POOL
+
+#include "header.h"  // [M[ IGNORE ]M]
+#include <stdatomic.h>
+
+// size class free lists for small fixed size objects, every thread pops and
+// pushes on its own cache and only takes the depot lock to move a batch,
+// slabs come from libc and stay resident for reuse
+
+#define POOL_CLASS_SIZE 16
+#define POOL_MAX_SIZE 256
+#define POOL_CLASSES (POOL_MAX_SIZE / POOL_CLASS_SIZE)
+#define POOL_SLAB_SIZE 16384
+#define POOL_BATCH 32
+#define POOL_CACHE_LIMIT 128
+
+typedef struct _PoolBlock {
+    struct _PoolBlock *next;
+} PoolBlock;
+
+typedef struct _PoolDepot {
+    atomic_flag lock;
+    PoolBlock *free;
+    size_t count;
+    size_t slabs;
+    size_t allocs;
+    size_t hits;
+    size_t refills;
+} PoolDepot;
+
+typedef struct _PoolCache {
+    PoolBlock *free;
+    size_t count;
+    size_t allocs;
+    size_t hits;
+} PoolCache;
+
+typedef struct _PoolStats {
+    size_t allocs;
+    size_t hits;
+    size_t refills;
+    size_t slabs;
+    size_t resident;
+    size_t cached;
+} PoolStats;
+
+// one entry per class, a zeroed atomic_flag is not guaranteed to read as clear
+#define _POOL_DEPOT_INIT {.lock = ATOMIC_FLAG_INIT}
+PoolDepot _pool_depots[POOL_CLASSES] = {
+    _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT,
+    _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT,
+    _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT,
+    _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT, _POOL_DEPOT_INIT,
+};
+_Static_assert(POOL_CLASSES == 16, "_pool_depots needs one _POOL_DEPOT_INIT per class");
+PCT_THREAD_LOCAL PoolCache _pool_caches[POOL_CLASSES];
+
+// -1 for sizes the pool does not serve
+int pool_class(size_t size)
+{
+    if (size == 0 || size > POOL_MAX_SIZE) return -1;
+    return (size + POOL_CLASS_SIZE - 1) / POOL_CLASS_SIZE - 1;
+}
+
+void _pool_lock(PoolDepot *depot)
+{
+    while (atomic_flag_test_and_set_explicit(&depot->lock, memory_order_acquire)) {}
+}
+
+void _pool_unlock(PoolDepot *depot)
+{
+    atomic_flag_clear_explicit(&depot->lock, memory_order_release);
+}
+
+// counters are kept per thread and published whenever the depot is locked anyway
+void _pool_publish(PoolDepot *depot, PoolCache *cache)
+{
+    depot->allocs += cache->allocs;
+    depot->hits += cache->hits;
+    cache->allocs = 0;
+    cache->hits = 0;
+}
+
+void _pool_refill(int index, PoolCache *cache)
+{
+    PoolDepot *depot = &_pool_depots[index];
+    _pool_lock(depot);
+    _pool_publish(depot, cache);
+    depot->refills++;
+    while (depot->free != NULL && cache->count < POOL_BATCH) {
+        PoolBlock *block = depot->free;
+        depot->free = block->next;
+        depot->count--;
+        block->next = cache->free;
+        cache->free = block;
+        cache->count++;
+    }
+    _pool_unlock(depot);
+    if (cache->free != NULL) return;
+    // carve a new slab straight into the cache
+    size_t size = (index + 1) * POOL_CLASS_SIZE;
+    char *slab = pct_allocator_libc.malloc(NULL, POOL_SLAB_SIZE);
+    if (slab == NULL) return;
+    for (size_t offset = 0; offset + size <= POOL_SLAB_SIZE; offset += size) {
+        PoolBlock *block = (PoolBlock *)(slab + offset);
+        block->next = cache->free;
+        cache->free = block;
+        cache->count++;
+    }
+    _pool_lock(depot);
+    depot->slabs++;
+    _pool_unlock(depot);
+}
+
+void _pool_flush(int index, PoolCache *cache, size_t count)
+{
+    if (cache->free == NULL) return;
+    PoolBlock *first = cache->free;
+    PoolBlock *last = first;
+    size_t moved = 1;
+    while (moved < count && last->next != NULL) {
+        last = last->next;
+        moved++;
+    }
+    cache->free = last->next;
+    cache->count -= moved;
+    PoolDepot *depot = &_pool_depots[index];
+    _pool_lock(depot);
+    _pool_publish(depot, cache);
+    last->next = depot->free;
+    depot->free = first;
+    depot->count += moved;
+    _pool_unlock(depot);
+}
+
+void *pool_take(int index)
+{
+    PoolCache *cache = &_pool_caches[index];
+    cache->allocs++;
+    if (cache->free == NULL) {
+        _pool_refill(index, cache);
+        if (cache->free == NULL) return NULL;
+    } else {
+        cache->hits++;
+    }
+    PoolBlock *block = cache->free;
+    cache->free = block->next;
+    cache->count--;
+    return block;
+}
+
+void pool_give(void *object, int index)
+{
+    PoolCache *cache = &_pool_caches[index];
+    PoolBlock *block = object;
+    block->next = cache->free;
+    cache->free = block;
+    cache->count++;
+    if (cache->count > POOL_CACHE_LIMIT) _pool_flush(index, cache, POOL_BATCH);
+}
+
+// sizes past POOL_MAX_SIZE go to pct_mallloc, free with the same size
+void *pool_alloc(size_t size)
+{
+    int index = pool_class(size);
+    return index < 0 ? pct_mallloc(size) : pool_take(index);
+}
+
+void pool_free(void *object, size_t size)
+{
+    if (object == NULL) return;
+    int index = pool_class(size);
+    index < 0 ? pct_free(object) : pool_give(object, index);
+}
+
+// hands the calling thread's cached blocks back, call it before a thread exits
+void pool_flush()
+{
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        PoolCache *cache = &_pool_caches[i];
+        _pool_flush(i, cache, cache->count);
+    }
+}
+
+void _pool_stats_add(PoolStats *stats, int index)
+{
+    PoolDepot *depot = &_pool_depots[index];
+    PoolCache *cache = &_pool_caches[index];
+    _pool_lock(depot);
+    stats->allocs += depot->allocs + cache->allocs;
+    stats->hits += depot->hits + cache->hits;
+    stats->refills += depot->refills;
+    stats->slabs += depot->slabs;
+    stats->resident += depot->slabs * POOL_SLAB_SIZE;
+    stats->cached += depot->count + cache->count;
+    _pool_unlock(depot);
+}
+
+// published counters of all threads plus the calling thread's own,
+// size picks one class, 0 sums all of them
+PoolStats pool_stats(size_t size)
+{
+    PoolStats stats = {0, 0, 0, 0, 0, 0};
+    int index = pool_class(size);
+    if (index >= 0) {
+        _pool_stats_add(&stats, index);
+        return stats;
+    }
+    for (int i = 0; i < POOL_CLASSES; i++) _pool_stats_add(&stats, i);
+    return stats;
+}
+
+void pool_print()
+{
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        PoolStats stats = pool_stats((i + 1) * POOL_CLASS_SIZE);
+        if (stats.allocs == 0 && stats.slabs == 0) continue;
+        double rate = stats.allocs > 0 ? 100.0 * stats.hits / stats.allocs : 0;
+        printf("[(POOL) => s:%d, a:%zu, h:%.1f%%, r:%zu, c:%zu, m:%zu]\n", (i + 1) * POOL_CLASS_SIZE, stats.allocs, rate, stats.refills, stats.cached, stats.resident);
+    }
+}
+
+#endif
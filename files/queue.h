@@ -73,4 +73,134 @@ void Queue_foreachItem(Queue *this, QUEUE_FOREACH_FUNC func, void *arg) {
     Chain_foreach_from_head((Chain *)this, func, arg);
 }
 
+// contiguous fifo, a power of two ring that only allocates when it grows,
+// pops release retained values like Queue does
+
+#define RING_QUEUE_MIN_CAPACITY 16
+
+typedef struct _RingQueue {
+    struct _Object;
+    void **items;
+    int capacity;
+    int head;
+    int size;
+    bool retain;
+} RingQueue;
+
+RingQueue *RingQueue_new(bool isRetain) {
+    RingQueue *queue = (RingQueue *)pct_mallloc(sizeof(RingQueue));
+    Object_init(queue, PCT_OBJ_RINGQUEUE);
+    queue->items = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+    queue->size = 0;
+    queue->retain = isRetain;
+    return queue;
+}
+
+void RingQueue_print(RingQueue *this) {
+    printf("[(RINGQUEUE) => p:%p, s:%d, c:%d]\n", this, this->size, this->capacity);
+}
+
+int RingQueue_size(RingQueue *this) {
+    return this->size;
+}
+
+// copies count items starting at the logical index from into out, wrapping around the ring
+void _ring_queue_copy_out(RingQueue *this, int from, int count, void **out) {
+    int start = (this->head + from) & (this->capacity - 1);
+    int first = MIN(count, this->capacity - start);
+    memcpy(out, this->items + start, sizeof(void *) * first);
+    memcpy(out + first, this->items, sizeof(void *) * (count - first));
+}
+
+bool RingQueue_reserve(RingQueue *this, int capacity) {
+    if (capacity <= this->capacity) return true;
+    int size = MAX(this->capacity, RING_QUEUE_MIN_CAPACITY);
+    while (size < capacity) {
+        if (size > INT_MAX / 2) return false;
+        size *= 2;
+    }
+    void **items = pct_mallloc(sizeof(void *) * size);
+    if (items == NULL) return false;
+    if (this->size > 0) _ring_queue_copy_out(this, 0, this->size, items);
+    if (this->items != NULL) pct_free(this->items);
+    this->items = items;
+    this->capacity = size;
+    this->head = 0;
+    return true;
+}
+
+void RingQueue_push(RingQueue *this, void *data) {
+    if (this->size == this->capacity && !RingQueue_reserve(this, this->size + 1)) tools_error("ring queue out of memory");
+    if (this->retain) Object_retain(data);
+    this->items[(this->head + this->size) & (this->capacity - 1)] = data;
+    this->size++;
+}
+
+void *RingQueue_pop(RingQueue *this) {
+    if (this->size == 0) return NULL;
+    void *data = this->items[this->head];
+    this->head = (this->head + 1) & (this->capacity - 1);
+    this->size--;
+    if (this->retain) Object_release(data);
+    return data;
+}
+
+void *RingQueue_peek(RingQueue *this) {
+    return this->size > 0 ? this->items[this->head] : NULL;
+}
+
+// index 0 is the next one to pop
+void *RingQueue_get(RingQueue *this, int index) {
+    if (index < 0 || index >= this->size) return NULL;
+    return this->items[(this->head + index) & (this->capacity - 1)];
+}
+
+// pushes count items in order with at most one allocation
+void RingQueue_pushN(RingQueue *this, void **items, int count) {
+    if (count <= 0) return;
+    if (count > INT_MAX - this->size || !RingQueue_reserve(this, this->size + count)) tools_error("ring queue out of memory");
+    if (this->retain) {
+        for (int i = 0; i < count; i++) Object_retain(items[i]);
+    }
+    int start = (this->head + this->size) & (this->capacity - 1);
+    int first = MIN(count, this->capacity - start);
+    memcpy(this->items + start, items, sizeof(void *) * first);
+    memcpy(this->items, items + first, sizeof(void *) * (count - first));
+    this->size += count;
+}
+
+// pops up to max items into out in fifo order, returns how many
+int RingQueue_popN(RingQueue *this, void **out, int max) {
+    int count = MIN(max, this->size);
+    if (count <= 0) return 0;
+    _ring_queue_copy_out(this, 0, count, out);
+    this->head = (this->head + count) & (this->capacity - 1);
+    this->size -= count;
+    if (this->retain) {
+        for (int i = 0; i < count; i++) Object_release(out[i]);
+    }
+    return count;
+}
+
+void RingQueue_clear(RingQueue *this) {
+    if (this->retain) {
+        for (int i = 0; i < this->size; i++) Object_release(this->items[(this->head + i) & (this->capacity - 1)]);
+    }
+    this->head = 0;
+    this->size = 0;
+}
+
+void RingQueue_free(RingQueue *this) {
+    RingQueue_clear(this);
+    if (this->items != NULL) pct_free(this->items);
+    this->items = NULL;
+    Object_free(this);
+}
+
+void RingQueue_foreachItem(RingQueue *this, QUEUE_FOREACH_FUNC func, void *arg) {
+    for (int i = 0; i < this->size; i++) func(this->items[(this->head + i) & (this->capacity - 1)], arg);
+}
+
 #endif
@@ -73,4 +73,110 @@ void Stack_foreachItem(Stack *this, STACK_FOREACH_FUNC func, void *arg) {
     Chain_foreach_from_tail((Chain *)this, func, arg);
 }
 
+// contiguous lifo, grows by doubling and never allocates on pop,
+// pops release retained values like Stack does
+
+#define ARRAY_STACK_MIN_CAPACITY 16
+
+typedef struct _ArrayStack {
+    struct _Object;
+    void **items;
+    int capacity;
+    int size;
+    bool retain;
+} ArrayStack;
+
+ArrayStack *ArrayStack_new(bool isRetain) {
+    ArrayStack *stack = (ArrayStack *)pct_mallloc(sizeof(ArrayStack));
+    Object_init(stack, PCT_OBJ_ARRAYSTACK);
+    stack->items = NULL;
+    stack->capacity = 0;
+    stack->size = 0;
+    stack->retain = isRetain;
+    return stack;
+}
+
+void ArrayStack_print(ArrayStack *this) {
+    printf("[(ARRAYSTACK) => p:%p, s:%d, c:%d]\n", this, this->size, this->capacity);
+}
+
+int ArrayStack_size(ArrayStack *this) {
+    return this->size;
+}
+
+bool ArrayStack_reserve(ArrayStack *this, int capacity) {
+    if (capacity <= this->capacity) return true;
+    int size = this->capacity < INT_MAX / 2 ? this->capacity * 2 : INT_MAX;
+    size = MAX(size, MAX(capacity, ARRAY_STACK_MIN_CAPACITY));
+    void **items = pct_realloc(this->items, sizeof(void *) * size);
+    if (items == NULL) return false;
+    this->items = items;
+    this->capacity = size;
+    return true;
+}
+
+void ArrayStack_push(ArrayStack *this, void *data) {
+    if (this->size == this->capacity && !ArrayStack_reserve(this, this->size + 1)) tools_error("array stack out of memory");
+    if (this->retain) Object_retain(data);
+    this->items[this->size++] = data;
+}
+
+void *ArrayStack_pop(ArrayStack *this) {
+    if (this->size == 0) return NULL;
+    void *data = this->items[--this->size];
+    if (this->retain) Object_release(data);
+    return data;
+}
+
+void *ArrayStack_peek(ArrayStack *this) {
+    return this->size > 0 ? this->items[this->size - 1] : NULL;
+}
+
+// index 0 is the top
+void *ArrayStack_get(ArrayStack *this, int index) {
+    if (index < 0 || index >= this->size) return NULL;
+    return this->items[this->size - 1 - index];
+}
+
+// pushes items in order, the last one ends up on top
+void ArrayStack_pushN(ArrayStack *this, void **items, int count) {
+    if (count <= 0) return;
+    if (count > INT_MAX - this->size || !ArrayStack_reserve(this, this->size + count)) tools_error("array stack out of memory");
+    if (this->retain) {
+        for (int i = 0; i < count; i++) Object_retain(items[i]);
+    }
+    memcpy(this->items + this->size, items, sizeof(void *) * count);
+    this->size += count;
+}
+
+// pops up to max items into out, top first, returns how many
+int ArrayStack_popN(ArrayStack *this, void **out, int max) {
+    int count = MIN(max, this->size);
+    if (count <= 0) return 0;
+    for (int i = 0; i < count; i++) out[i] = this->items[this->size - 1 - i];
+    this->size -= count;
+    if (this->retain) {
+        for (int i = 0; i < count; i++) Object_release(out[i]);
+    }
+    return count;
+}
+
+void ArrayStack_clear(ArrayStack *this) {
+    if (this->retain) {
+        for (int i = this->size - 1; i >= 0; i--) Object_release(this->items[i]);
+    }
+    this->size = 0;
+}
+
+void ArrayStack_free(ArrayStack *this) {
+    ArrayStack_clear(this);
+    if (this->items != NULL) pct_free(this->items);
+    this->items = NULL;
+    Object_free(this);
+}
+
+void ArrayStack_foreachItem(ArrayStack *this, STACK_FOREACH_FUNC func, void *arg) {
+    for (int i = this->size - 1; i >= 0; i--) func(this->items[i], arg);
+}
+
 #endif
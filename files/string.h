@@ -5,11 +5,16 @@
 
 #define STRING_MIN_CAPACITY 128
 
+// short contents live in buffer, data moves to the heap past it
+#define STRING_INLINE_CAPACITY 32
+
 typedef struct _String {
     struct _Object;
     int length;
     int capacity;
     char *data;
+    uint64_t hash;
+    char buffer[STRING_INLINE_CAPACITY];
 } String;
 
 String *String_new()
@@ -17,26 +22,63 @@ String *String_new()
     String *string = (String *)pct_mallloc(sizeof(String));
     Object_init(string, PCT_OBJ_STRING);
     string->length = 0;
-    string->capacity = STRING_MIN_CAPACITY + 1;
-    string->data = pct_mallloc(string->capacity);
+    string->capacity = STRING_INLINE_CAPACITY;
+    string->data = string->buffer;
     string->data[string->length] = '\0';
+    string->hash = 0;
     return string;
 }
 
+bool String_isInline(String *this)
+{
+    return this->data == this->buffer;
+}
+
 void String_free(String *this)
 {
-    pct_free(this->data);
+    if (!String_isInline(this)) pct_free(this->data);
     Object_free(this);
 }
 
 void _string_check_capacity(String *this, int length)
 {
     if (this->capacity >= length + 1) return;
-    while (this->capacity < length + 1 && this->capacity * 2 < INT_MAX) {
-        this->capacity *= 2;
-        if (this->capacity <= 0) this->capacity--;
+    int capacity = String_isInline(this) ? STRING_MIN_CAPACITY : this->capacity;
+    while (capacity < length + 1 && capacity < INT_MAX / 2) {
+        capacity *= 2;
+    }
+    if (capacity < length + 1) capacity = length + 1;
+    if (String_isInline(this)) {
+        char *data = pct_mallloc(capacity);
+        memcpy(data, this->buffer, this->length + 1);
+        this->data = data;
+    } else {
+        this->data = pct_realloc(this->data, capacity);
+    }
+    this->capacity = capacity;
+}
+
+// makes room for at least capacity bytes of content, growth stays geometric
+String *String_reserve(String *this, int capacity)
+{
+    _string_check_capacity(this, capacity);
+    return this;
+}
+
+// gives back unused capacity, moving short contents inline again
+String *String_shrink(String *this)
+{
+    if (String_isInline(this) || this->capacity == this->length + 1) return this;
+    if (this->length < STRING_INLINE_CAPACITY) {
+        memcpy(this->buffer, this->data, this->length + 1);
+        pct_free(this->data);
+        this->data = this->buffer;
+        this->capacity = STRING_INLINE_CAPACITY;
+        return this;
     }
-    this->data = pct_realloc(this->data, this->capacity);
+    this->data = pct_realloc(this->data, this->length + 1);
+    this->capacity = this->length + 1;
+    return this;
 }
 
 String *String_appendChar(String *this, char c)
@@ -45,6 +87,7 @@ String *String_appendChar(String *this, char c)
     this->data[this->length] = c;
     this->length++;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -55,6 +98,7 @@ String *String_prependChar(String *this, char c)
     this->data[0] = c;
     this->length++;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -67,6 +111,7 @@ String *String_appendArr(String *this, char arr[])
     memmove(this->data + this->length, arr, len);
     this->length += len;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -75,10 +120,23 @@ String *String_prependArr(String *this, char arr[])
     if (arr == NULL) return this;
     int len = strlen(arr);
     if (len == 0) return this;
+    _string_check_capacity(this, this->length + len);
     memmove(this->data + len, this->data, this->length);
     memmove(this->data, arr, len);
     this->length += len;
     this->data[this->length] = '\0';
+    this->hash = 0;
+    return this;
+}
+
+String *String_appendBytes(String *this, const char *bytes, int len)
+{
+    if (bytes == NULL || len <= 0) return this;
+    _string_check_capacity(this, this->length + len);
+    memmove(this->data + this->length, bytes, len);
+    this->length += len;
+    this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -91,6 +149,7 @@ String *String_appendStr(String *this, char *str)
     memmove(this->data + this->length, str, len);
     this->length += len;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -104,6 +163,7 @@ String *String_prependStr(String *this, char *str)
     memmove(this->data, str, len);
     this->length += len;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -128,6 +188,7 @@ String *String_insert(String *this, int at, String *that)
     pct_free(temp);
     this->length += that->length;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -142,6 +203,7 @@ String *String_delete(String *this, int from, int to)
     memmove(dst, src, cnt);
     this->length -= (to - from + 1);
     this->data[this->length] = '\0';
+    this->hash = 0;
     _string_check_capacity(this, this->length + 1);
     return this;
 }
@@ -160,19 +222,75 @@ String *String_clear(String *this)
 {
     this->length = 0;
     this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
-unsigned long String_hash(String *this)
+// cached until the next change, 0 means not computed yet
+uint64_t String_hash(String *this)
 {
-    char *str = this->data;
-    unsigned long hash = 5381;
-    int c = *(str++);
-    while (c) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-        c = *(str++);
-    }
-    return hash;
+    if (this->hash == 0) this->hash = hash_bytes(this->data, this->length);
+    return this->hash;
+}
+
+// views borrow data, any change to the String invalidates them
+StrView String_view(String *this)
+{
+    return StrView_new(this->data, this->length);
+}
+
+StrView String_viewRange(String *this, int from, int to)
+{
+    if (this->length <= 0) return StrView_new(this->data, 0);
+    limit_range(this->length, true, &from, &to);
+    return StrView_new(this->data + from, to - from + 1);
+}
+
+String *String_appendView(String *this, StrView view)
+{
+    return String_appendBytes(this, view.ptr, view.len);
+}
+
+String *String_prependView(String *this, StrView view)
+{
+    if (view.len <= 0) return this;
+    _string_check_capacity(this, this->length + view.len);
+    memmove(this->data + view.len, this->data, this->length);
+    memmove(this->data, view.ptr, view.len);
+    this->length += view.len;
+    this->data[this->length] = '\0';
+    this->hash = 0;
+    return this;
+}
+
+String *String_setView(String *this, StrView view)
+{
+    _string_check_capacity(this, view.len);
+    memmove(this->data, view.ptr, view.len);
+    this->length = view.len;
+    this->data[this->length] = '\0';
+    this->hash = 0;
+    return this;
+}
+
+String *String_fromView(StrView view)
+{
+    return String_appendView(String_new(), view);
+}
+
+bool String_equalView(String *this, StrView view)
+{
+    return StrView_equal(String_view(this), view);
+}
+
+int String_compareView(String *this, StrView view)
+{
+    return StrView_compare(String_view(this), view);
+}
+
+int String_findView(String *this, int from, StrView target)
+{
+    return StrView_find(String_view(this), from, target);
 }
 
 int String_findNext(String *this, int from, char *target)
@@ -180,10 +298,7 @@ int String_findNext(String *this, int from, char *target)
     int len = strlen(target);
     if (from < 0) from = from + this->length;
     if (this->length <= 0 || from < 0 || from > this->length || len <= 0) return -1;
-    char *ptr = strstr(this->data + from, target);
-    if (ptr == NULL) return -1;
-    int pos = ptr - this->data;
-    return pos;
+    return StrView_find(String_view(this), from, StrView_new(target, len));
 }
 
 int String_findLast(String *this, int to, char *target)
@@ -191,39 +306,29 @@ int String_findLast(String *this, int to, char *target)
     int len = strlen(target);
     if (to < 0) to = to + this->length;
     if (this->length <= 0 || to < 0 || to > this->length || len <= 0) return -1;
-    int containIndex = to - len + 1;
-    int nextIndex = this->length - 1;
-    int foundIndex = -1;
-    char *ptr = NULL;
-    while (nextIndex >= 0) {
-        if ((ptr = strstr(this->data + nextIndex, target)) != NULL && (foundIndex = ptr - this->data) <= containIndex) return foundIndex;
-        nextIndex--;
-    }
-    return -1;
+    StrSearch search;
+    StrSearch_init(&search, StrView_new(target, len));
+    return StrSearch_last(&search, String_view(this), to - len + 1);
 }
 
-// [N, index1, index2, ... indexN]
+// [N, index1, index2, ... indexN], overlapping matches included
 int *String_findAll(String *this, char *target)
 {
     int size = 128;
     int *result = (int *)pct_mallloc(sizeof(int) * size);
-    for (size_t i = 0; i < size; i++) {
-        result[i] = -1;
-    }
+    result[0] = 0;
+    StrView view = String_view(this);
+    StrSearch search;
+    StrSearch_init(&search, StrView_from(target));
     int foundIndex = -1;
     int nextIndex = 0;
-    int lastRecorded = -1;
-    while ((foundIndex = String_findNext(this, nextIndex, target)) >= 0) {
-        nextIndex++;
-        if (foundIndex != lastRecorded) {
-            result[0]++;
-            if (result[0] > size - 1) {
-                size <<= 2;
-                result = (int *)pct_realloc(result, size);
-            }
-            result[result[0]] = foundIndex;
-            lastRecorded = foundIndex;
+    while ((foundIndex = StrSearch_next(&search, view, nextIndex)) >= 0) {
+        if (result[0] + 1 >= size) {
+            size <<= 1;
+            result = (int *)pct_realloc(result, sizeof(int) * size);
         }
+        result[++result[0]] = foundIndex;
+        nextIndex = foundIndex + 1;
     }
     return result;
 }
@@ -252,7 +357,7 @@ String *String_set(String *this, char *str)
 
 void String_print(String *this)
 {
-    printf("<STRING:%d,%lu,%s>\n", this->length, String_hash(this), this->data);
+    printf("<STRING:%d,%llu,%s>\n", this->length, (unsigned long long)String_hash(this), this->data);
 }
 
 char *String_dump(String *this)
@@ -269,23 +374,117 @@ String *String_clone(String *this)
     return s;
 }
 
+// formats straight into the spare capacity, only retries when it overflows
+String *String_appendFormatV(String *this, const char *template, va_list lst)
+{
+    va_list lstCopy;
+    va_copy(lstCopy, lst);
+    int spare = this->capacity - this->length;
+    int len = vsnprintf(this->data + this->length, spare, template, lst);
+    if (len >= spare) {
+        _string_check_capacity(this, this->length + len);
+        vsnprintf(this->data + this->length, len + 1, template, lstCopy);
+    }
+    va_end(lstCopy);
+    if (len < 0) {
+        this->data[this->length] = '\0';
+        return this;
+    }
+    this->length += len;
+    this->hash = 0;
+    return this;
+}
+
+String *String_appendFormat(String *this, const char *template, ...)
+{
+    va_list lst;
+    va_start(lst, template);
+    String_appendFormatV(this, template, lst);
+    va_end(lst);
+    return this;
+}
+
 String *String_format(char *template, ...)
 {
     va_list lst;
-    va_list lstCopy;
     va_start(lst, template);
-    va_copy(lstCopy, lst);
-    int bufsz = vsnprintf(NULL, 0, template, lst);
-    char *t = pct_mallloc(bufsz + 1);
-    vsnprintf(t, bufsz + 1, template, lstCopy);
+    String *s = String_appendFormatV(String_new(), template, lst);
     va_end(lst);
-    va_end(lstCopy);
-    String *s = String_new();
-    String_appendStr(s, t);
-    pct_free(t);
     return s;
 }
 
+char _string_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// writes digits backwards ending at end, returns the first written byte
+char *_string_write_uint(char *end, unsigned long long value)
+{
+    while (value >= 100) {
+        int pair = (value % 100) * 2;
+        value /= 100;
+        *--end = _string_digit_pairs[pair + 1];
+        *--end = _string_digit_pairs[pair];
+    }
+    if (value >= 10) {
+        *--end = _string_digit_pairs[value * 2 + 1];
+        *--end = _string_digit_pairs[value * 2];
+    } else {
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+String *String_appendUInt(String *this, unsigned long long value)
+{
+    char temp[24];
+    char *end = temp + sizeof(temp);
+    char *start = _string_write_uint(end, value);
+    return String_appendBytes(this, start, end - start);
+}
+
+String *String_appendInt(String *this, long long value)
+{
+    char temp[24];
+    char *end = temp + sizeof(temp);
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    char *start = _string_write_uint(end, magnitude);
+    if (value < 0) *--start = '-';
+    return String_appendBytes(this, start, end - start);
+}
+
+// fixed notation with precision digits (0 ~ 17) after the point,
+// magnitudes past 1e18 fall back to the formatter
+String *String_appendDouble(String *this, double value, int precision)
+{
+    if (isnan(value)) return String_appendBytes(this, "nan", 3);
+    if (isinf(value)) return value < 0 ? String_appendBytes(this, "-inf", 4) : String_appendBytes(this, "inf", 3);
+    precision = MAX(0, MIN(17, precision));
+    if (fabs(value) >= 1e18) return String_appendFormat(this, "%.*f", precision, value);
+    if (signbit(value)) {
+        String_appendChar(this, '-');
+        value = -value;
+    }
+    unsigned long long scale = 1;
+    for (int i = 0; i < precision; i++) scale *= 10;
+    unsigned long long integer = (unsigned long long)value;
+    double fraction = (value - (double)integer) * (double)scale;
+    unsigned long long decimal = (unsigned long long)(fraction + 0.5);
+    if (decimal >= scale) {
+        integer++;
+        decimal -= scale;
+    }
+    String_appendUInt(this, integer);
+    if (precision == 0) return this;
+    char temp[24];
+    char *end = temp + sizeof(temp);
+    char *start = _string_write_uint(end, decimal);
+    while (end - start < precision) *--start = '0';
+    *--start = '.';
+    return String_appendBytes(this, start, end - start);
+}
+
 String* String_repeat(String *this, int count)
 {
     if (count <= 0 || this->length <= 0) return this;
@@ -299,25 +498,26 @@ String* String_repeat(String *this, int count)
 
 String *String_subString(String *this, int from, int to)
 {
-    limit_range(this->length, true, &from, &to);
     String *s = String_new();
-    int len = to - from + 1;
-    char *temp = pct_mallloc(len + 1);
-    memmove(temp, this->data + from, len);
-    temp[len] = '\0';
-    String_appendStr(s, temp);
-    pct_free(temp);
-    return s; 
+    if (this->length <= 0) return s;
+    limit_range(this->length, true, &from, &to);
+    return String_appendBytes(s, this->data + from, to - from + 1);
 }
 
 int String_compare(String *this, String *that)
 {
-    return strcmp(this->data, that->data);
+    int len = MIN(this->length, that->length);
+    int result = memcmp(this->data, that->data, len);
+    if (result != 0) return result;
+    return this->length - that->length;
 }
 
 bool String_equal(String *this, String *that)
 {
-    return String_compare(this, that) == 0;
+    if (this == that) return true;
+    if (this->length != that->length) return false;
+    if (this->hash != 0 && that->hash != 0 && this->hash != that->hash) return false;
+    return memcmp(this->data, that->data, this->length) == 0;
 }
 
 char String_getChar(String *this, int index)
@@ -330,39 +530,26 @@ String *String_setChar(String *this, int index, char c)
 {
     if (index < 0 || index >= this->length || c == '\0') return this;
     this->data[index] = c;
+    this->hash = 0;
     return this;
 }
 
 void String_reverse(String *this)
 {
-    int left = 0;
-    int right = this->length - 1;
-    char temp;
-    while(left < right) {
-        temp = this->data[left];
-        this->data[left] = this->data[right];
-        this->data[right] = temp;
-        left++;
-        right--;
-    }
+    this->hash = 0;
+    bytes_reverse(this->data, this->length);
 }
 
 void String_upper(String *this)
 {
-    int index = 0;
-    while(index < this->length) {
-        this->data[index] = toupper(this->data[index]);
-        index = index + 1;
-    }
+    this->hash = 0;
+    bytes_upper(this->data, this->length);
 }
 
 void String_lower(String *this)
 {
-    int index = 0;
-    while(index < this->length) {
-        this->data[index] = tolower(this->data[index]);
-        index = index + 1;
-    }
+    this->hash = 0;
+    bytes_lower(this->data, this->length);
 }
 
 bool String_startsWith(String *this, char *target)
@@ -380,51 +567,98 @@ bool String_contains(String *this, char *target)
     return String_findNext(this, 0, target) >= 0;
 }
 
-String *String_replace(String *this, char *target, char *relacement, int from, int to, int count)
+// moves the bytes of that into this and frees that
+String *_string_take(String *this, String *that)
 {
-    limit_range(this->length, true, &from, &to);
-    int thisLen = String_length(this);
-    int targetLen = strlen(target);
-    int replacementLen = strlen(relacement);
-    if (targetLen <= 0 || count == 0) return this;
-    int findIndex = from;
-    int fromIndex = 0;
-    int foundIndex = -1;
-    int replaceCount = 0;
-    String *result = String_new();
-    String *temp = NULL;
-    while((foundIndex = String_findNext(this, findIndex, target)) >= 0) {
-        if (foundIndex >= to) break;
-        temp = String_subString(this, fromIndex, foundIndex - 1);
-        String_append(result, String_get(temp));
-        String_free(temp);
-        String_append(result, relacement);
-        fromIndex = foundIndex + targetLen;
-        findIndex = foundIndex + targetLen;
-        replaceCount++;
-        if (count > 0 && replaceCount >= count) break;
+    if (String_isInline(that)) {
+        String_setView(this, String_view(that));
+    } else {
+        if (!String_isInline(this)) pct_free(this->data);
+        this->data = that->data;
+        this->capacity = that->capacity;
+        this->length = that->length;
+        this->hash = 0;
+        that->data = that->buffer;
     }
-    temp = String_subString(this, fromIndex, this->length - 1);
-    String_append(result, String_get(temp));
-    String_free(temp);
-    String_set(this, String_get(result));
-    String_free(result);
+    String_free(that);
     return this;
 }
 
+// matches are searched from [from, to), the output is sized once:
+// shorter replacements are written in place, longer ones after a counting pass
+String *_string_replace_view(String *this, StrView target, StrView replacement, int from, int to, int count)
+{
+    if (target.len <= 0 || count == 0 || this->length <= 0) return this;
+    StrView view = String_view(this);
+    StrSearch search;
+    StrSearch_init(&search, target);
+    int read = from;
+    int write = from;
+    int found = -1;
+    int matches = 0;
+    if (replacement.len <= target.len) {
+        while ((found = StrSearch_next(&search, view, read)) >= 0 && found < to) {
+            memmove(this->data + write, this->data + read, found - read);
+            write += found - read;
+            memmove(this->data + write, replacement.ptr, replacement.len);
+            write += replacement.len;
+            read = found + target.len;
+            if (++matches == count) break;
+        }
+        if (matches == 0) return this;
+        memmove(this->data + write, this->data + read, this->length - read);
+        this->length = write + this->length - read;
+        this->data[this->length] = '\0';
+        this->hash = 0;
+        return this;
+    }
+    while ((found = StrSearch_next(&search, view, read)) >= 0 && found < to) {
+        read = found + target.len;
+        if (++matches == count) break;
+    }
+    if (matches == 0) return this;
+    String *result = String_new();
+    _string_check_capacity(result, this->length + matches * (replacement.len - target.len));
+    String_appendBytes(result, this->data, from);
+    read = from;
+    for (int i = 0; i < matches; i++) {
+        found = StrSearch_next(&search, view, read);
+        String_appendBytes(result, this->data + read, found - read);
+        String_appendView(result, replacement);
+        read = found + target.len;
+    }
+    String_appendBytes(result, this->data + read, this->length - read);
+    return _string_take(this, result);
+}
+
+String *String_replace(String *this, char *target, char *relacement, int from, int to, int count)
+{
+    if (this->length <= 0) return this;
+    limit_range(this->length, true, &from, &to);
+    return _string_replace_view(this, StrView_from(target), StrView_from(relacement), from, to, count);
+}
+
+String *String_replaceView(String *this, StrView target, StrView replacement, int count)
+{
+    return _string_replace_view(this, target, replacement, 0, this->length, count);
+}
+
+String *String_replaceAll(String *this, char *target, char *replacement)
+{
+    return String_replaceView(this, StrView_from(target), StrView_from(replacement), -1);
+}
+
 String *_string_trim_both(String *this, bool isLeft, bool isRight)
 {
     if (this->length == 0) return this;
-    if (isLeft) {
-        int start = 0;
-        while(start < this->length && isspace(this->data[start])) start++;
-        if (start > 0)  String_deleteStarting(this, start);
-    }
-    if (isRight) {
-        int end = this->length - 1;
-        while(end >= 0 && isspace(this->data[end])) end--;
-        if (end < this->length - 1) String_deleteEnding(this, end + 1);
-    }
+    StrView view = String_view(this);
+    if (isLeft) view = StrView_trimLeft(view);
+    if (isRight) view = StrView_trimRight(view);
+    if (view.len == this->length) return this;
+    memmove(this->data, view.ptr, view.len);
+    this->length = view.len;
+    this->data[this->length] = '\0';
+    this->hash = 0;
     return this;
 }
 
@@ -0,0 +1,233 @@
+// strview
+
+#ifndef H_PCT_STRVIEW
+#define H_PCT_STRVIEW
+
+#include "header.h"  // [M[ IGNORE ]M]
+#include "hash.h"  // [M[ IGNORE ]M]
+#include "bytes.h"  // [M[ IGNORE ]M]
+
+// a borrowed, immutable byte range, nothing here allocates
+// the bytes are not NUL terminated and must outlive the view
+typedef struct _StrView {
+    const char *ptr;
+    int len;
+} StrView;
+
+StrView StrView_new(const char *ptr, int len)
+{
+    StrView view = {ptr, ptr == NULL || len < 0 ? 0 : len};
+    return view;
+}
+
+StrView StrView_from(const char *str)
+{
+    return StrView_new(str, str == NULL ? 0 : strlen(str));
+}
+
+bool StrView_isEmpty(StrView this)
+{
+    return this.len == 0;
+}
+
+// half open [from, to), negatives count from the end
+StrView StrView_slice(StrView this, int from, int to)
+{
+    if (from < 0) from = MAX(0, this.len + from);
+    if (to < 0) to = MAX(0, this.len + to);
+    from = MIN(from, this.len);
+    to = MIN(to, this.len);
+    if (from >= to) return StrView_new(this.ptr + from, 0);
+    return StrView_new(this.ptr + from, to - from);
+}
+
+char StrView_getChar(StrView this, int index)
+{
+    if (index < 0 || index >= this.len) return '\0';
+    return this.ptr[index];
+}
+
+int StrView_findChar(StrView this, int from, char c)
+{
+    if (from < 0 || from >= this.len) return -1;
+    const char *ptr = memchr(this.ptr + from, c, this.len - from);
+    return ptr == NULL ? -1 : ptr - this.ptr;
+}
+
+// substring search, memchr (vectorized in libc) filters on the first byte
+// while candidates are rare, after too many false hits it switches to
+// boyer-moore-horspool with a skip table built once per StrSearch
+#define STRVIEW_FILTER_MISSES 16
+
+typedef struct _StrSearch {
+    StrView needle;
+    int prepared;
+    int skip[256];
+} StrSearch;
+
+void StrSearch_init(StrSearch *this, StrView needle)
+{
+    this->needle = needle;
+    this->prepared = 0;
+}
+
+void _strsearch_prepare(StrSearch *this, bool isReverse)
+{
+    int len = this->needle.len;
+    const unsigned char *ptr = (const unsigned char *)this->needle.ptr;
+    for (int i = 0; i < 256; i++) this->skip[i] = len;
+    if (isReverse) {
+        for (int i = len - 1; i >= 1; i--) this->skip[ptr[i]] = i;
+    } else {
+        for (int i = 0; i < len - 1; i++) this->skip[ptr[i]] = len - 1 - i;
+    }
+    this->prepared = isReverse ? -1 : 1;
+}
+
+// first match starting at or after from
+int StrSearch_next(StrSearch *this, StrView hay, int from)
+{
+    StrView needle = this->needle;
+    if (from < 0) from = 0;
+    if (needle.len <= 0 || from + needle.len > hay.len) return -1;
+    const char *base = hay.ptr;
+    const char *ptr = base + from;
+    const char *end = base + hay.len - needle.len;
+    if (this->prepared != 1) {
+        int misses = 0;
+        while (ptr <= end) {
+            ptr = memchr(ptr, needle.ptr[0], end - ptr + 1);
+            if (ptr == NULL) return -1;
+            if (memcmp(ptr + 1, needle.ptr + 1, needle.len - 1) == 0) return ptr - base;
+            ptr++;
+            if (++misses > STRVIEW_FILTER_MISSES && needle.len > 1) break;
+        }
+        if (ptr > end) return -1;
+        _strsearch_prepare(this, false);
+    }
+    int *skip = this->skip;
+    int last = needle.len - 1;
+    unsigned char tail = needle.ptr[last];
+    while (ptr <= end) {
+        unsigned char c = ptr[last];
+        if (c == tail && memcmp(ptr, needle.ptr, last) == 0) return ptr - base;
+        ptr += skip[c];
+    }
+    return -1;
+}
+
+// last match starting at or before to
+int StrSearch_last(StrSearch *this, StrView hay, int to)
+{
+    StrView needle = this->needle;
+    if (needle.len <= 0 || needle.len > hay.len) return -1;
+    int start = MIN(to, hay.len - needle.len);
+    if (start < 0) return -1;
+    const char *base = hay.ptr;
+    int pos = start;
+    char head = needle.ptr[0];
+    if (this->prepared != -1) {
+        int misses = 0;
+        while (pos >= 0) {
+            if (base[pos] == head) {
+                if (memcmp(base + pos + 1, needle.ptr + 1, needle.len - 1) == 0) return pos;
+                if (++misses > STRVIEW_FILTER_MISSES && needle.len > 1) break;
+            }
+            pos--;
+        }
+        if (pos < 0) return -1;
+        _strsearch_prepare(this, true);
+    }
+    int *skip = this->skip;
+    while (pos >= 0) {
+        unsigned char c = base[pos];
+        if (c == (unsigned char)head && memcmp(base + pos + 1, needle.ptr + 1, needle.len - 1) == 0) return pos;
+        pos -= skip[c];
+    }
+    return -1;
+}
+
+int StrView_find(StrView this, int from, StrView target)
+{
+    if (from < 0) from = MAX(0, from + this.len);
+    StrSearch search;
+    StrSearch_init(&search, target);
+    return StrSearch_next(&search, this, from);
+}
+
+int StrView_findLast(StrView this, StrView target)
+{
+    StrSearch search;
+    StrSearch_init(&search, target);
+    return StrSearch_last(&search, this, this.len);
+}
+
+int StrView_compare(StrView this, StrView that)
+{
+    int len = MIN(this.len, that.len);
+    int result = len > 0 ? memcmp(this.ptr, that.ptr, len) : 0;
+    if (result != 0) return result;
+    return this.len - that.len;
+}
+
+bool StrView_equal(StrView this, StrView that)
+{
+    return this.len == that.len && (this.len == 0 || memcmp(this.ptr, that.ptr, this.len) == 0);
+}
+
+bool StrView_startsWith(StrView this, StrView target)
+{
+    return target.len <= this.len && StrView_equal(StrView_new(this.ptr, target.len), target);
+}
+
+bool StrView_endsWith(StrView this, StrView target)
+{
+    return target.len <= this.len && StrView_equal(StrView_new(this.ptr + this.len - target.len, target.len), target);
+}
+
+uint64_t StrView_hash(StrView this)
+{
+    return hash_bytes(this.ptr, this.len);
+}
+
+StrView StrView_trimLeft(StrView this)
+{
+    int start = bytes_scan(this.ptr, this.len, BYTES_CLASS_SPACE, false);
+    return StrView_new(this.ptr + start, this.len - start);
+}
+
+StrView StrView_trimRight(StrView this)
+{
+    int end = bytes_scan_back(this.ptr, this.len, BYTES_CLASS_SPACE, false) + 1;
+    return StrView_new(this.ptr, end);
+}
+
+StrView StrView_trim(StrView this)
+{
+    return StrView_trimRight(StrView_trimLeft(this));
+}
+
+// StrView rest = StrView_from("a,b,c"), token;
+// while (StrView_split(&rest, StrView_from(","), &token)) { ... }
+bool StrView_split(StrView *this, StrView delimiter, StrView *token)
+{
+    if (this->ptr == NULL) return false;
+    int pos = StrView_find(*this, 0, delimiter);
+    if (pos < 0) {
+        *token = *this;
+        this->ptr = NULL;
+        this->len = 0;
+        return true;
+    }
+    *token = StrView_new(this->ptr, pos);
+    this->ptr += pos + delimiter.len;
+    this->len -= pos + delimiter.len;
+    return true;
+}
+
+bool StrView_splitChar(StrView *this, char delimiter, StrView *token)
+{
+    return StrView_split(this, StrView_new(&delimiter, 1), token);
+}
+
+#endif
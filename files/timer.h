@@ -69,7 +69,7 @@ bool _timer_execute() {
     #endif
     double seconds = func(data);
     // complete
-    seconds > 0 ? _timer_insert(timer, seconds) : pct_free(timer);
+    seconds > 0 ? _timer_insert(timer, seconds) : Object_free(timer);
     return false;
 }
 
@@ -88,8 +88,7 @@ Timer *timer_delay(double seconds, void *data, TIMER_FUNC func) {
     } else if (seconds == 0) {
         seconds = 0.00001;
     }
-    Timer *timer = (Timer *)pct_mallloc(sizeof(Timer));
-    Object_init(timer, PCT_OBJ_TIMER);
+    Timer *timer = (Timer *)Object_newPooled(sizeof(Timer), PCT_OBJ_TIMER);
     timer->data = data;
     timer->func = func;
     timer->next = NULL;
@@ -111,7 +110,7 @@ void timer_clean(TIMER_CLEAN callback) {
         }
         timer_cancel(current);
         current->next = NULL;
-        pct_free(current);
+        Object_free(current);
         current = next;
     }
     _timer_queue_head = NULL;
@@ -123,14 +123,13 @@ char *tools_format(char *msg, ...)
 {
     va_list lst;
     va_start(lst, msg);
-    _tools_format(msg, lst);
-    return msg;
+    return _tools_format(msg, lst);
 }
 
+// putenv keeps the pointer, so the text is not freed
 void tools_set_env(char *name, char *value) {
     char *text = tools_format("%s=%s", name, value);
     putenv(text);
-    pct_free(text);
 }
 
 char *tools_get_env(char *name) {
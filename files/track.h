@@ -0,0 +1,260 @@
+// track
+
+#ifndef H_PCT_TRACK
+#define H_PCT_TRACK
+
+#include "header.h"  // [M[ IGNORE ]M]
+
+// opt-in heap profiling for pct_mallloc/pct_realloc/pct_free, build with
+// PCT_ALLOC_TRACK to get live/peak bytes, per objType totals and a sampled
+// call-site histogram, dump it all with pct_track_json()
+// without the flag nothing here is compiled and the pct_ calls stay untouched
+
+#ifdef PCT_ALLOC_TRACK
+
+#include <stdatomic.h>
+
+#define TRACK_HEADER 16
+#define TRACK_TYPES PCT_OBJ_TYPES
+#define TRACK_SITES 512
+
+typedef struct _TrackType {
+    atomic_size_t count;
+    atomic_size_t bytes;
+    atomic_size_t total;
+} TrackType;
+
+typedef struct _TrackSite {
+    void *site;
+    size_t samples;
+    size_t bytes;
+} TrackSite;
+
+typedef struct _TrackStats {
+    size_t liveBytes;
+    size_t liveCount;
+    size_t peakBytes;
+    size_t totalBytes;
+    size_t totalCount;
+} TrackStats;
+
+atomic_size_t _track_live_bytes;
+atomic_size_t _track_live_count;
+atomic_size_t _track_peak_bytes;
+atomic_size_t _track_total_bytes;
+atomic_size_t _track_total_count;
+TrackType _track_types[TRACK_TYPES];
+
+// sites are only touched once every _track_sample allocations
+atomic_uint _track_sample;
+atomic_flag _track_sites_lock = ATOMIC_FLAG_INIT;
+TrackSite _track_sites[TRACK_SITES];
+size_t _track_sites_dropped = 0;
+PCT_THREAD_LOCAL unsigned _track_countdown = 0;
+
+// every block is prefixed with its size, the header keeps malloc's alignment
+#define _TRACK_BLOCK(object) ((char *)(object) - TRACK_HEADER)
+#define _TRACK_SIZE(block) (*(size_t *)(block))
+
+void _track_grow(size_t size)
+{
+    size_t live = atomic_fetch_add_explicit(&_track_live_bytes, size, memory_order_relaxed) + size;
+    size_t peak = atomic_load_explicit(&_track_peak_bytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&_track_peak_bytes, &peak, live, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+void _track_shrink(size_t size)
+{
+    atomic_fetch_sub_explicit(&_track_live_bytes, size, memory_order_relaxed);
+}
+
+void _track_site(void *site, size_t size)
+{
+    while (atomic_flag_test_and_set_explicit(&_track_sites_lock, memory_order_acquire)) {}
+    size_t index = ((uintptr_t)site >> 4) % TRACK_SITES;
+    size_t probe = 0;
+    while (probe < TRACK_SITES && _track_sites[index].site != NULL && _track_sites[index].site != site) {
+        index = (index + 1) % TRACK_SITES;
+        probe++;
+    }
+    if (probe == TRACK_SITES) {
+        _track_sites_dropped++;
+    } else {
+        _track_sites[index].site = site;
+        _track_sites[index].samples++;
+        _track_sites[index].bytes += size;
+    }
+    atomic_flag_clear_explicit(&_track_sites_lock, memory_order_release);
+}
+
+void _track_sample_site(void *site, size_t size)
+{
+    unsigned every = atomic_load_explicit(&_track_sample, memory_order_relaxed);
+    if (every == 0 || site == NULL) return;
+    if (_track_countdown == 0 || _track_countdown > every) _track_countdown = every;
+    if (--_track_countdown == 0) _track_site(site, size);
+}
+
+void *_pct_track_malloc(PctAllocator *allocator, size_t size, void *site)
+{
+    char *block = allocator->malloc(allocator->context, TRACK_HEADER + size);
+    if (block == NULL) return NULL;
+    _TRACK_SIZE(block) = size;
+    atomic_fetch_add_explicit(&_track_live_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_track_total_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_track_total_bytes, size, memory_order_relaxed);
+    _track_grow(size);
+    _track_sample_site(site, size);
+    return block + TRACK_HEADER;
+}
+
+void *_pct_track_realloc(PctAllocator *allocator, void *object, size_t size)
+{
+    if (object == NULL) return _pct_track_malloc(allocator, size, NULL);
+    char *block = _TRACK_BLOCK(object);
+    size_t old = _TRACK_SIZE(block);
+    block = allocator->realloc(allocator->context, block, TRACK_HEADER + size);
+    if (block == NULL) return NULL;
+    _TRACK_SIZE(block) = size;
+    if (size > old) {
+        atomic_fetch_add_explicit(&_track_total_bytes, size - old, memory_order_relaxed);
+        _track_grow(size - old);
+    } else {
+        _track_shrink(old - size);
+    }
+    return block + TRACK_HEADER;
+}
+
+void _pct_track_free(PctAllocator *allocator, void *object)
+{
+    if (object == NULL) return;
+    char *block = _TRACK_BLOCK(object);
+    atomic_fetch_sub_explicit(&_track_live_count, 1, memory_order_relaxed);
+    _track_shrink(_TRACK_SIZE(block));
+    allocator->free(allocator->context, block);
+}
+
+// called from Object_init/Object_free, pooled objects are counted here too
+void _pct_track_object(int type, size_t size, int delta)
+{
+    TrackType *track = &_track_types[type];
+    if (delta > 0) {
+        atomic_fetch_add_explicit(&track->count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&track->bytes, size, memory_order_relaxed);
+        atomic_fetch_add_explicit(&track->total, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(&track->count, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&track->bytes, size, memory_order_relaxed);
+    }
+}
+
+// requested size of a block from pct_mallloc/pct_realloc
+size_t pct_track_size(void *object)
+{
+    return object == NULL ? 0 : _TRACK_SIZE(_TRACK_BLOCK(object));
+}
+
+// record one call site out of every allocations, 0 turns sampling off
+void pct_track_sample(unsigned every)
+{
+    atomic_store_explicit(&_track_sample, every, memory_order_relaxed);
+}
+
+TrackStats pct_track_stats()
+{
+    TrackStats stats;
+    stats.liveBytes = atomic_load_explicit(&_track_live_bytes, memory_order_relaxed);
+    stats.liveCount = atomic_load_explicit(&_track_live_count, memory_order_relaxed);
+    stats.peakBytes = atomic_load_explicit(&_track_peak_bytes, memory_order_relaxed);
+    stats.totalBytes = atomic_load_explicit(&_track_total_bytes, memory_order_relaxed);
+    stats.totalCount = atomic_load_explicit(&_track_total_count, memory_order_relaxed);
+    return stats;
+}
+
+// peak starts over from the current live bytes
+void pct_track_reset_peak()
+{
+    size_t live = atomic_load_explicit(&_track_live_bytes, memory_order_relaxed);
+    atomic_store_explicit(&_track_peak_bytes, live, memory_order_relaxed);
+}
+
+void _track_json_add(JValue *object, const char *key, JValue value)
+{
+    size_t len = strlen(key);
+    char *copy = malloc(len + 1);
+    memcpy(copy, key, len + 1);
+    json_object_add_member(object, copy, &value);
+}
+
+JValue _track_json_object()
+{
+    JValue object = json_new(JSON_NULL);
+    json_set_object(&object, 0);
+    return object;
+}
+
+// {liveBytes, liveCount, peakBytes, totalBytes, totalCount, types: {String: {count, bytes, total}}, sample, dropped, sites: [{site, samples, bytes}]}
+JValue pct_track_value()
+{
+    TrackStats stats = pct_track_stats();
+    JValue root = _track_json_object();
+    _track_json_add(&root, "liveBytes", json_new_number(stats.liveBytes));
+    _track_json_add(&root, "liveCount", json_new_number(stats.liveCount));
+    _track_json_add(&root, "peakBytes", json_new_number(stats.peakBytes));
+    _track_json_add(&root, "totalBytes", json_new_number(stats.totalBytes));
+    _track_json_add(&root, "totalCount", json_new_number(stats.totalCount));
+    JValue types = _track_json_object();
+    for (int i = 1; i < TRACK_TYPES; i++) {
+        TrackType *track = &_track_types[i];
+        size_t total = atomic_load_explicit(&track->total, memory_order_relaxed);
+        if (total == 0) continue;
+        JValue type = _track_json_object();
+        _track_json_add(&type, "count", json_new_number(atomic_load_explicit(&track->count, memory_order_relaxed)));
+        _track_json_add(&type, "bytes", json_new_number(atomic_load_explicit(&track->bytes, memory_order_relaxed)));
+        _track_json_add(&type, "total", json_new_number(total));
+        const char *name = pct_object_types[i].name;
+        char key[16];
+        if (name == NULL) snprintf(key, sizeof(key), "%d", i);
+        _track_json_add(&types, name != NULL ? name : key, type);
+    }
+    _track_json_add(&root, "types", types);
+    _track_json_add(&root, "sample", json_new_number(atomic_load_explicit(&_track_sample, memory_order_relaxed)));
+    JValue sites = json_new(JSON_NULL);
+    json_set_array(&sites, 0);
+    while (atomic_flag_test_and_set_explicit(&_track_sites_lock, memory_order_acquire)) {}
+    _track_json_add(&root, "dropped", json_new_number(_track_sites_dropped));
+    for (int i = 0; i < TRACK_SITES; i++) {
+        TrackSite *track = &_track_sites[i];
+        if (track->site == NULL) continue;
+        char address[32];
+        snprintf(address, sizeof(address), "%p", track->site);
+        JValue site = _track_json_object();
+        _track_json_add(&site, "site", json_new_string(address, strlen(address)));
+        _track_json_add(&site, "samples", json_new_number(track->samples));
+        _track_json_add(&site, "bytes", json_new_number(track->bytes));
+        json_array_add_element(&sites, &site);
+    }
+    atomic_flag_clear_explicit(&_track_sites_lock, memory_order_release);
+    _track_json_add(&root, "sites", sites);
+    return root;
+}
+
+// encoded with json_encode, release it with free
+char *pct_track_json()
+{
+    JValue value = pct_track_value();
+    char *text = NULL;
+    json_encode(&text, &value);
+    json_free(&value);
+    return text;
+}
+
+void pct_track_print()
+{
+    TrackStats stats = pct_track_stats();
+    printf("[(TRACK) => l:%zu, n:%zu, p:%zu, t:%zu]\n", stats.liveBytes, stats.liveCount, stats.peakBytes, stats.totalCount);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,256 @@
+// typed array
+
+#ifndef H_PCT_TYPEDARRAY
+#define H_PCT_TYPEDARRAY
+
+#include "header.h"  // [M[ IGNORE ]M]
+#include "object.h"  // [M[ IGNORE ]M]
+
+// unboxed numbers in one contiguous buffer, data starts on a TYPED_ARRAY_ALIGN boundary
+// so loops over it vectorize, the typed structs below share TypedArray's layout
+
+#define TYPED_ARRAY_ALIGN 64
+#define TYPED_ARRAY_MIN_CAPACITY 16
+
+typedef struct _TypedArray {
+    struct _Object;
+    void *block;
+    void *data;
+    int length;
+    int capacity;
+    int itemSize;
+} TypedArray;
+
+bool _typed_array_resize(TypedArray *this, int capacity)
+{
+    char *block = pct_mallloc((size_t)capacity * this->itemSize + TYPED_ARRAY_ALIGN);
+    if (block == NULL) return false;
+    void *data = (void *)(((uintptr_t)block + TYPED_ARRAY_ALIGN - 1) & ~(uintptr_t)(TYPED_ARRAY_ALIGN - 1));
+    if (this->length > 0) memcpy(data, this->data, (size_t)this->length * this->itemSize);
+    if (this->block != NULL) pct_free(this->block);
+    this->block = block;
+    this->data = data;
+    this->capacity = capacity;
+    return true;
+}
+
+// doubles, so pushing n values costs O(log n) copies
+bool _typed_array_grow(TypedArray *this, int length)
+{
+    if (length <= this->capacity) return true;
+    if (length < 0) return false;
+    int capacity = this->capacity < INT_MAX / 2 ? this->capacity * 2 : INT_MAX;
+    capacity = MAX(capacity, MAX(length, TYPED_ARRAY_MIN_CAPACITY));
+    return _typed_array_resize(this, capacity);
+}
+
+TypedArray *_TypedArray_new(size_t size, int type, int itemSize, int capacity)
+{
+    TypedArray *array = (TypedArray *)pct_mallloc(size);
+    Object_init(array, type);
+    array->block = NULL;
+    array->data = NULL;
+    array->length = 0;
+    array->capacity = 0;
+    array->itemSize = itemSize;
+    if (capacity > 0) _typed_array_resize(array, capacity);
+    return array;
+}
+
+void TypedArray_free(void *_this)
+{
+    TypedArray *this = _this;
+    if (this->block != NULL) pct_free(this->block);
+    this->block = NULL;
+    this->data = NULL;
+    Object_free(this);
+}
+
+bool TypedArray_reserve(void *_this, int capacity)
+{
+    TypedArray *this = _this;
+    if (capacity <= this->capacity) return true;
+    return _typed_array_resize(this, capacity);
+}
+
+bool TypedArray_shrink(void *_this)
+{
+    TypedArray *this = _this;
+    if (this->length == this->capacity) return true;
+    return _typed_array_resize(this, this->length);
+}
+
+void TypedArray_clear(void *_this)
+{
+    ((TypedArray *)_this)->length = 0;
+}
+
+int TypedArray_length(void *_this)
+{
+    return ((TypedArray *)_this)->length;
+}
+
+bool TypedArray_pushMany(void *_this, const void *values, int count)
+{
+    TypedArray *this = _this;
+    if (count <= 0) return count == 0;
+    if (count > INT_MAX - this->length) return false;
+    if (!_typed_array_grow(this, this->length + count)) return false;
+    memcpy((char *)this->data + (size_t)this->length * this->itemSize, values, (size_t)count * this->itemSize);
+    this->length += count;
+    return true;
+}
+
+// copy of [from, to), empty when the range is invalid
+void *_TypedArray_slice(TypedArray *this, size_t size, int from, int to)
+{
+    bool isValid = from >= 0 && to <= this->length && from < to;
+    TypedArray *other = _TypedArray_new(size, ((Object *)this)->objType, this->itemSize, isValid ? to - from : 0);
+    if (isValid) TypedArray_pushMany(other, (char *)this->data + (size_t)from * this->itemSize, to - from);
+    return other;
+}
+
+void _TypedArray_print(TypedArray *this, char *name)
+{
+    printf("[(%s) => p:%p, l:%d, c:%d]\n", name, this, this->length, this->capacity);
+}
+
+// get/pop/min/max give 0 when there is no such value,
+// search is a binary search on a sorted array and returns the first match or -1,
+// sum runs four accumulators so float sums can differ from a plain loop in the last bits
+#define _TYPED_ARRAY_DEFINE(NAME, TYPE, TOTAL, OBJTYPE, LABEL) \
+typedef struct _##NAME { \
+    struct _Object; \
+    void *block; \
+    TYPE *data; \
+    int length; \
+    int capacity; \
+    int itemSize; \
+} NAME; \
+\
+NAME *NAME##_new(int capacity) \
+{ \
+    return (NAME *)_TypedArray_new(sizeof(NAME), OBJTYPE, sizeof(TYPE), capacity); \
+} \
+\
+void NAME##_free(NAME *this) \
+{ \
+    TypedArray_free(this); \
+} \
+\
+void NAME##_print(NAME *this) \
+{ \
+    _TypedArray_print((TypedArray *)this, LABEL); \
+} \
+\
+bool NAME##_push(NAME *this, TYPE value) \
+{ \
+    if (this->length == this->capacity && !_typed_array_grow((TypedArray *)this, this->length + 1)) return false; \
+    this->data[this->length++] = value; \
+    return true; \
+} \
+\
+bool NAME##_pushMany(NAME *this, const TYPE *values, int count) \
+{ \
+    return TypedArray_pushMany(this, values, count); \
+} \
+\
+TYPE NAME##_pop(NAME *this) \
+{ \
+    return this->length > 0 ? this->data[--this->length] : 0; \
+} \
+\
+TYPE NAME##_get(NAME *this, int index) \
+{ \
+    return index >= 0 && index < this->length ? this->data[index] : 0; \
+} \
+\
+bool NAME##_set(NAME *this, int index, TYPE value) \
+{ \
+    if (index < 0 || index >= this->length) return false; \
+    this->data[index] = value; \
+    return true; \
+} \
+\
+NAME *NAME##_slice(NAME *this, int from, int to) \
+{ \
+    return _TypedArray_slice((TypedArray *)this, sizeof(NAME), from, to); \
+} \
+\
+int _##NAME##_compare(const void *a, const void *b) \
+{ \
+    TYPE x = *(const TYPE *)a; \
+    TYPE y = *(const TYPE *)b; \
+    return (x > y) - (x < y); \
+} \
+\
+void NAME##_sort(NAME *this) \
+{ \
+    if (this->length > 1) qsort(this->data, this->length, sizeof(TYPE), _##NAME##_compare); \
+} \
+\
+int NAME##_search(NAME *this, TYPE value) \
+{ \
+    int low = 0; \
+    int high = this->length; \
+    while (low < high) { \
+        int middle = low + (high - low) / 2; \
+        if (this->data[middle] < value) { \
+            low = middle + 1; \
+        } else { \
+            high = middle; \
+        } \
+    } \
+    return low < this->length && this->data[low] == value ? low : -1; \
+} \
+\
+TOTAL NAME##_sum(NAME *this) \
+{ \
+    const TYPE *data = this->data; \
+    TOTAL a = 0, b = 0, c = 0, d = 0; \
+    int i = 0; \
+    for (; i + 4 <= this->length; i += 4) { \
+        a += data[i]; \
+        b += data[i + 1]; \
+        c += data[i + 2]; \
+        d += data[i + 3]; \
+    } \
+    for (; i < this->length; i++) a += data[i]; \
+    return (a + b) + (c + d); \
+} \
+\
+TYPE NAME##_min(NAME *this) \
+{ \
+    if (this->length == 0) return 0; \
+    const TYPE *data = this->data; \
+    TYPE value = data[0]; \
+    for (int i = 1; i < this->length; i++) value = data[i] < value ? data[i] : value; \
+    return value; \
+} \
+\
+TYPE NAME##_max(NAME *this) \
+{ \
+    if (this->length == 0) return 0; \
+    const TYPE *data = this->data; \
+    TYPE value = data[0]; \
+    for (int i = 1; i < this->length; i++) value = data[i] > value ? data[i] : value; \
+    return value; \
+}
+
+_TYPED_ARRAY_DEFINE(IntArray, int, int64_t, PCT_OBJ_INTARRAY, "INTARRAY")
+_TYPED_ARRAY_DEFINE(Int64Array, int64_t, int64_t, PCT_OBJ_INT64ARRAY, "INT64ARRAY")
+_TYPED_ARRAY_DEFINE(FloatArray, float, double, PCT_OBJ_FLOATARRAY, "FLOATARRAY")
+_TYPED_ARRAY_DEFINE(DoubleArray, double, double, PCT_OBJ_DOUBLEARRAY, "DOUBLEARRAY")
+
+//
+// DoubleArray *samples = DoubleArray_new(0);
+// DoubleArray_push(samples, 1.5);
+// DoubleArray_pushMany(samples, values, count);
+// DoubleArray_sort(samples);
+// int at = DoubleArray_search(samples, 1.5);
+// double total = DoubleArray_sum(samples);
+// for (int i = 0; i < samples->length; i++) samples->data[i] *= 2;
+// Object_release(samples);
+//
+
+#endif
@@ -0,0 +1,296 @@
+// unrolled chain
+
+#ifndef H_PCT_UNROLLED
+#define H_PCT_UNROLLED
+
+#include "header.h"  // [M[ IGNORE ]M]
+#include "object.h"  // [M[ IGNORE ]M]
+
+// a Chain whose nodes hold up to UNROLLED_NODE_SIZE values each, nodes are plain
+// allocations without an Object header and values sit next to each other,
+// a node keeps its values in items[start, start + count) so both ends stay O(1),
+// only the end nodes ever get emptied by pops, middle nodes may be partly filled after a splice
+
+#define UNROLLED_NODE_SIZE 30
+
+typedef struct _UnrolledNode {
+    struct _UnrolledNode *next;
+    struct _UnrolledNode *last;
+    int start;
+    int count;
+    void *items[UNROLLED_NODE_SIZE];
+} UnrolledNode;
+
+// a plain value, pushes and pops invalidate it
+typedef struct _UnrolledCursor {
+    UnrolledNode *node;
+    int index;
+} UnrolledCursor;
+
+typedef struct _UnrolledChain {
+    struct _Object;
+    int size;
+    UnrolledNode *head;
+    UnrolledNode *tail;
+    UnrolledNode *spare;
+    UnrolledCursor cursor;
+    bool retain;
+} UnrolledChain;
+
+UnrolledChain *UnrolledChain_new(bool isRetain) {
+    UnrolledChain *chain = (UnrolledChain *)pct_mallloc(sizeof(UnrolledChain));
+    Object_init(chain, PCT_OBJ_UNROLLEDCHAIN);
+    chain->size = 0;
+    chain->head = NULL;
+    chain->tail = NULL;
+    chain->spare = NULL;
+    chain->cursor.node = NULL;
+    chain->cursor.index = 0;
+    chain->retain = isRetain;
+    return chain;
+}
+
+int UnrolledChain_size(UnrolledChain *this) {
+    return this->size;
+}
+
+// one emptied node is kept back so a push right after a pop does not allocate
+UnrolledNode *_unrolled_node_new(UnrolledChain *this, int start) {
+    UnrolledNode *node = this->spare;
+    if (node != NULL) {
+        this->spare = NULL;
+    } else {
+        node = pct_mallloc(sizeof(UnrolledNode));
+    }
+    node->next = NULL;
+    node->last = NULL;
+    node->start = start;
+    node->count = 0;
+    return node;
+}
+
+void _unrolled_node_free(UnrolledChain *this, UnrolledNode *node) {
+    if (this->spare == NULL) {
+        this->spare = node;
+    } else {
+        pct_free(node);
+    }
+}
+
+void UnrolledChain_push_to_head(UnrolledChain *this, void *data) {
+    if (this->retain) Object_retain(data);
+    UnrolledNode *head = this->head;
+    if (head == NULL || head->start == 0) {
+        UnrolledNode *node = _unrolled_node_new(this, UNROLLED_NODE_SIZE);
+        node->next = head;
+        if (head != NULL) {
+            head->last = node;
+        } else {
+            this->tail = node;
+        }
+        this->head = node;
+        head = node;
+    }
+    head->items[--head->start] = data;
+    head->count++;
+    this->size++;
+}
+
+void UnrolledChain_push_to_tail(UnrolledChain *this, void *data) {
+    if (this->retain) Object_retain(data);
+    UnrolledNode *tail = this->tail;
+    if (tail == NULL || tail->start + tail->count == UNROLLED_NODE_SIZE) {
+        UnrolledNode *node = _unrolled_node_new(this, 0);
+        node->last = tail;
+        if (tail != NULL) {
+            tail->next = node;
+        } else {
+            this->head = node;
+        }
+        this->tail = node;
+        tail = node;
+    }
+    tail->items[tail->start + tail->count] = data;
+    tail->count++;
+    this->size++;
+}
+
+void *UnrolledChain_pop_from_head(UnrolledChain *this) {
+    UnrolledNode *head = this->head;
+    if (head == NULL) return NULL;
+    void *data = head->items[head->start++];
+    head->count--;
+    this->size--;
+    if (head->count == 0) {
+        this->head = head->next;
+        if (this->head != NULL) {
+            this->head->last = NULL;
+        } else {
+            this->tail = NULL;
+        }
+        _unrolled_node_free(this, head);
+    }
+    if (this->retain) Object_release(data);
+    return data;
+}
+
+void *UnrolledChain_pop_from_tail(UnrolledChain *this) {
+    UnrolledNode *tail = this->tail;
+    if (tail == NULL) return NULL;
+    void *data = tail->items[tail->start + tail->count - 1];
+    tail->count--;
+    this->size--;
+    if (tail->count == 0) {
+        this->tail = tail->last;
+        if (this->tail != NULL) {
+            this->tail->next = NULL;
+        } else {
+            this->head = NULL;
+        }
+        _unrolled_node_free(this, tail);
+    }
+    if (this->retain) Object_release(data);
+    return data;
+}
+
+void *UnrolledChain_get_head(UnrolledChain *this) {
+    return this->head != NULL ? this->head->items[this->head->start] : NULL;
+}
+
+void *UnrolledChain_get_tail(UnrolledChain *this) {
+    return this->tail != NULL ? this->tail->items[this->tail->start + this->tail->count - 1] : NULL;
+}
+
+// moves every value of other to the end of this by relinking nodes, other is left empty,
+// references only need touching when the two chains disagree on retaining
+void UnrolledChain_splice(UnrolledChain *this, UnrolledChain *other) {
+    if (other == this || other->head == NULL) return;
+    if (this->retain != other->retain) {
+        for (UnrolledNode *node = other->head; node != NULL; node = node->next) {
+            for (int i = node->start; i < node->start + node->count; i++) {
+                if (this->retain) {
+                    Object_retain(node->items[i]);
+                } else {
+                    Object_release(node->items[i]);
+                }
+            }
+        }
+    }
+    if (this->tail != NULL) {
+        this->tail->next = other->head;
+        other->head->last = this->tail;
+    } else {
+        this->head = other->head;
+    }
+    this->tail = other->tail;
+    this->size += other->size;
+    other->head = NULL;
+    other->tail = NULL;
+    other->size = 0;
+    other->cursor.node = NULL;
+    other->cursor.index = 0;
+}
+
+UnrolledCursor UnrolledChain_reset_to_head(UnrolledChain *this) {
+    UnrolledCursor cursor = {this->head, this->head != NULL ? this->head->start : 0};
+    return cursor;
+}
+
+UnrolledCursor UnrolledChain_reset_to_tail(UnrolledChain *this) {
+    UnrolledCursor cursor = {this->tail, this->tail != NULL ? this->tail->start + this->tail->count - 1 : 0};
+    return cursor;
+}
+
+// returns the value under the cursor and steps towards the tail, NULL at the end
+void *UnrolledChain_next(UnrolledChain *this, UnrolledCursor *cursor) {
+    UnrolledNode *node = cursor->node;
+    if (node == NULL) return NULL;
+    void *data = node->items[cursor->index++];
+    if (cursor->index == node->start + node->count) {
+        cursor->node = node->next;
+        cursor->index = node->next != NULL ? node->next->start : 0;
+    }
+    return data;
+}
+
+// returns the value under the cursor and steps towards the head, NULL at the end
+void *UnrolledChain_last(UnrolledChain *this, UnrolledCursor *cursor) {
+    UnrolledNode *node = cursor->node;
+    if (node == NULL) return NULL;
+    void *data = node->items[cursor->index--];
+    if (cursor->index < node->start) {
+        cursor->node = node->last;
+        cursor->index = node->last != NULL ? node->last->start + node->last->count - 1 : 0;
+    }
+    return data;
+}
+
+void UnrolledChain_RESTE_TO_HEAD(UnrolledChain *this) {
+    this->cursor = UnrolledChain_reset_to_head(this);
+}
+
+void UnrolledChain_RESTE_TO_TAIL(UnrolledChain *this) {
+    this->cursor = UnrolledChain_reset_to_tail(this);
+}
+
+void *UnrolledChain_NEXT(UnrolledChain *this) {
+    return UnrolledChain_next(this, &this->cursor);
+}
+
+void *UnrolledChain_LAST(UnrolledChain *this) {
+    return UnrolledChain_last(this, &this->cursor);
+}
+
+typedef void (*UNROLLED_FOREACH_FUNC)(void *, void *);
+
+void UnrolledChain_foreach_from_head(UnrolledChain *this, UNROLLED_FOREACH_FUNC func, void *arg) {
+    for (UnrolledNode *node = this->head; node != NULL; node = node->next) {
+        for (int i = node->start; i < node->start + node->count; i++) func(node->items[i], arg);
+    }
+}
+
+void UnrolledChain_foreach_from_tail(UnrolledChain *this, UNROLLED_FOREACH_FUNC func, void *arg) {
+    for (UnrolledNode *node = this->tail; node != NULL; node = node->last) {
+        for (int i = node->start + node->count - 1; i >= node->start; i--) func(node->items[i], arg);
+    }
+}
+
+void UnrolledChain_clear(UnrolledChain *this) {
+    UnrolledNode *node = this->head;
+    while (node != NULL) {
+        UnrolledNode *next = node->next;
+        if (this->retain) {
+            for (int i = node->start; i < node->start + node->count; i++) Object_release(node->items[i]);
+        }
+        _unrolled_node_free(this, node);
+        node = next;
+    }
+    this->head = NULL;
+    this->tail = NULL;
+    this->size = 0;
+    this->cursor.node = NULL;
+}
+
+void UnrolledChain_print(UnrolledChain *this) {
+    int nodes = 0;
+    for (UnrolledNode *node = this->head; node != NULL; node = node->next) nodes++;
+    printf("[(UNROLLEDCHAIN) => p:%p, s:%d, n:%d]\n", this, this->size, nodes);
+}
+
+void UnrolledChain_free(UnrolledChain *this) {
+    UnrolledChain_clear(this);
+    if (this->spare != NULL) pct_free(this->spare);
+    this->spare = NULL;
+    Object_free(this);
+}
+
+//
+// UnrolledChain *list = UnrolledChain_new(false);
+// UnrolledChain_push_to_tail(list, item);
+// UnrolledCursor cursor = UnrolledChain_reset_to_head(list);
+// void *item;
+// while ((item = UnrolledChain_next(list, &cursor)) != NULL) {}
+// UnrolledChain_splice(list, other); // other moves to the end of list
+//
+
+#endif
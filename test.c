@@ -6,11 +6,46 @@
 #include "tools.h"
 #endif
 
+#ifdef PCT_ALLOC_TRACK
+// gc objects from a plain malloc creator stay out of the per type totals
+typedef struct _TestNode {
+    struct _GcObject;
+    int value;
+} TestNode;
+
+GcObject *_test_node_create(void *gache)
+{
+    TestNode *node = malloc(sizeof(TestNode));
+    GcObject_init(node, PCT_OBJ_USER);
+    node->value = 0;
+    return (GcObject *)node;
+}
+
+GcObject *_test_node_free(void *node)
+{
+    free(node);
+    return NULL;
+}
+
+void test_track_gache()
+{
+    Gallector *gallector = Gallector_new(0, _test_node_free);
+    Gache *gache = Gallector_cache(gallector, 4, _test_node_create);
+    for (int i = 0; i < 8; i++) Gache_get(gache, false);
+    Gallector_sweep(gallector);
+    TrackType *track = &_track_types[PCT_OBJ_USER];
+    assert(atomic_load(&track->count) == 0 && atomic_load(&track->bytes) == 0);
+    Gache_free(gache);
+    Gallector_free(gallector);
+}
+#endif
 
 int main(int argc, char const *argv[])
 {
+    #ifdef PCT_ALLOC_TRACK
+    test_track_gache();
+    #endif
     log_info("test...");
     //
     return 0;
 }
-
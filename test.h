@@ -3,9 +3,14 @@
 #include "./files/cargs.h"
 #include "./files/log.h"
 #include "./files/tools.h"
+#include "./files/arena.h"
+#include "./files/pool.h"
+#include "./files/hash.h"
+#include "./files/bytes.h"
 #include "./files/object.h"
 #include "./files/gallector.h"
 #include "./files/cstring.h"
+#include "./files/strview.h"
 #include "./files/string.h"
 #include "./files/cursor.h"
 #include "./files/hashkey.h"
@@ -13,12 +18,16 @@
 #include "./files/foliage.h"
 #include "./files/block.h"
 #include "./files/chain.h"
+#include "./files/unrolled.h"
 #include "./files/queue.h"
+#include "./files/lfqueue.h"
 #include "./files/stack.h"
 #include "./files/array.h"
+#include "./files/typedarray.h"
 #include "./files/time.h"
 #include "./files/timer.h"
 #include "./files/json.h"
+#include "./files/track.h"
 #include "./files/md5.h"
 #include "./files/base64.h"
 #include "./files/helpers.h"
\ No newline at end of file